@@ -0,0 +1,137 @@
+#include "arena.h"
+
+#include <stdalign.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "types.h"
+#include "util.h"
+
+struct ArenaBlock {
+	ArenaBlock *next;
+	size_t size; /* of `data` */
+	size_t used;
+	alignas(ARENA_ALIGN) char data[];
+};
+
+#define ALIGN_UP(n) (((n) + ARENA_ALIGN - 1) & ~(size_t) (ARENA_ALIGN - 1))
+
+static ArenaBlock *block_new(Arena *arena, size_t size)
+{
+	size = MAX(size, ARENA_BLOCK_SIZE - sizeof(ArenaBlock));
+	ArenaBlock *block = malloc(sizeof(ArenaBlock) + size);
+	if (block == NULL)
+	{
+		flogf(LOG_ERR, stderr, "failed to allocate arena block of size %zu\n", size);
+		exit(3);
+	}
+	block->next = NULL;
+	block->size = size;
+	block->used = 0;
+	arena->n_blocks++;
+	return block;
+}
+
+void *arena_alloc(Arena *arena, size_t size)
+{
+	size = ALIGN_UP(MAX(size, 1));
+	// after a reset, the blocks are used again in the same order
+	ArenaBlock *block = arena->cur;
+	while (block != NULL && block->size - block->used < size)
+		block = block->next;
+	if (block == NULL)
+	{
+		block = block_new(arena, size);
+		if (arena->first == NULL)
+			arena->first = block;
+		else
+		{
+			ArenaBlock *tail = (arena->cur != NULL) ? arena->cur : arena->first;
+			while (tail->next != NULL)
+				tail = tail->next;
+			tail->next = block;
+		}
+	}
+	arena->cur = block;
+	void *ret = block->data + block->used;
+	block->used += size;
+	arena->last = ret;
+	arena->n_allocs++;
+	return ret;
+}
+
+void *arena_calloc(Arena *arena, size_t size)
+{
+	return memset(arena_alloc(arena, size), 0, size);
+}
+
+void *arena_realloc(Arena *arena, void *ptr, size_t old_size, size_t new_size)
+{
+	if (ptr == NULL)
+		return arena_alloc(arena, new_size);
+	ArenaBlock *block = arena->cur;
+	if (ptr == arena->last && block != NULL)
+	{
+		size_t start = (char *) ptr - block->data;
+		if (ALIGN_UP(new_size) <= block->size - start)
+		{
+			block->used = start + ALIGN_UP(MAX(new_size, 1));
+			return ptr;
+		}
+	}
+	void *ret = arena_alloc(arena, new_size);
+	memcpy(ret, ptr, MIN(old_size, new_size));
+	return ret;
+}
+
+void arena_reset(Arena *arena)
+{
+	for (ArenaBlock *block = arena->first; block != NULL; block = block->next)
+		block->used = 0;
+	arena->cur = arena->first;
+	arena->last = NULL;
+	arena->n_allocs = 0;
+}
+
+void arena_free(Arena *arena)
+{
+	ArenaBlock *block = arena->first;
+	while (block != NULL)
+	{
+		ArenaBlock *next = block->next;
+		free(block);
+		block = next;
+	}
+	*arena = (Arena) {0};
+}
+
+#ifdef ARENA_DEBUG
+static _Thread_local size_t n_mallocs;
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t n, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+
+void *__wrap_malloc(size_t size)
+{
+	n_mallocs++;
+	return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t n, size_t size)
+{
+	n_mallocs++;
+	return __real_calloc(n, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size)
+{
+	n_mallocs++;
+	return __real_realloc(ptr, size);
+}
+
+size_t arena_debug_mallocs(void)
+{
+	return n_mallocs;
+}
+#endif
@@ -0,0 +1,49 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+#include "types.h"
+
+/* A region allocator. Allocations are carved out of large blocks and are
+ * never freed one by one: `arena_reset` takes them all back in one step but
+ * keeps the blocks, so work that is repeated (per file, per diagnostic)
+ * stops calling malloc once the arena has grown to fit it, and `arena_free`
+ * gives the blocks back.
+ *
+ * A zeroed Arena is empty and ready to use. Only one thread may use an arena
+ * at a time.
+ */
+
+#define ARENA_BLOCK_SIZE (64 * 1024)
+#define ARENA_ALIGN 16
+
+typedef struct ArenaBlock ArenaBlock;
+
+typedef struct {
+	ArenaBlock *first;
+	ArenaBlock *cur; /* the block allocations are taken from */
+	void *last; /* the latest allocation, which can grow in place */
+	size_t n_allocs; /* since the last reset */
+	size_t n_blocks; /* malloc'd over the arena's lifetime */
+} Arena;
+
+/* Returns `size` bytes aligned to ARENA_ALIGN, or exits if out of memory. */
+void *arena_alloc(Arena *arena, size_t size);
+void *arena_calloc(Arena *arena, size_t size);
+/* Moves an allocation of `old_size` bytes into one of `new_size` bytes. The
+ * latest allocation is grown in place if its block has room.
+ */
+void *arena_realloc(Arena *arena, void *ptr, size_t old_size, size_t new_size);
+/* Takes back every allocation, keeping the blocks for reuse. */
+void arena_reset(Arena *arena);
+void arena_free(Arena *arena);
+
+#ifdef ARENA_DEBUG
+/* malloc, calloc and realloc calls made by the calling thread so far. Debug
+ * builds link with -Wl,--wrap for each of them to count these.
+ */
+size_t arena_debug_mallocs(void);
+#endif
+
+#endif /* ARENA_H */
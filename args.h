@@ -15,6 +15,7 @@ enum {
 	FORCE_OVERWRITE = BIT(0),
 	NO_COLOR = BIT(1),
 	DEBUG = BIT(2),
+	STATS = BIT(3), /* print counters at the end, see stats.h */
 };
 
 #endif /* ARGS_H */
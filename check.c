@@ -0,0 +1,200 @@
+#include "check.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "lexer.h"
+#include "token_table.h"
+#include "types.h"
+#include "util.h"
+
+const u32 check_option_sets[CHECK_N_OPTION_SETS] = {
+	0,
+	LEXER_COALESCE_LITERALS,
+	LEXER_SKIP_COMMENTS,
+	LEXER_COALESCE_LITERALS | LEXER_SKIP_COMMENTS,
+};
+
+static size_t n_checks, n_failed;
+
+bool check(bool ok, const char *fmt, ...)
+{
+	n_checks++;
+	if (ok)
+		return true;
+	n_failed++;
+	va_list arg_list;
+	va_start(arg_list, fmt);
+	fprintf(stderr, "check failed: ");
+	vfprintf(stderr, fmt, arg_list);
+	va_end(arg_list);
+	return false;
+}
+
+s32 check_finish(const char *program)
+{
+	if (n_failed == 0)
+	{
+		printf("%s: %zu checks passed\n", program, n_checks);
+		return 0;
+	}
+	flogf(LOG_ERR, stderr, "%s: %zu of %zu checks failed\n", program, n_failed, n_checks);
+	return 1;
+}
+
+static u64 rng_state;
+
+void check_rng_seed(u64 seed)
+{
+	rng_state = seed;
+}
+
+u64 check_rng(void)
+{
+	u64 z = (rng_state += 0x9E3779B97F4A7C15);
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EB;
+	return z ^ (z >> 31);
+}
+
+u32 check_rng_below(u32 n)
+{
+	return (n == 0) ? 0 : check_rng() % n;
+}
+
+/* what generated sources are made of, most of it well-formed */
+static const struct {
+	const char *text;
+	u32 weight;
+	bool error; /* whether it can make the lexer raise an error */
+} fragments[] = {
+	{ " ", 40, false }, { "\n", 15, false }, { "\t", 5, false },
+	{ "x", 10, false }, { "count_2", 10, false }, { "func", 3, false }, { "s32", 3, false },
+	{ "return", 2, false },
+	{ ":=", 5, false }, { "=", 5, false }, { "+", 4, false }, { "->", 2, false }, { "...", 1, false },
+	{ ";", 8, false }, { ",", 3, false },
+	{ "(", 4, false }, { ")", 4, false }, { "{", 2, false }, { "}", 2, false }, { "[", 1, false },
+	{ "]", 1, false },
+	{ "0", 3, false }, { "531", 6, false }, { "0x1F", 2, false }, { "0o17", 1, false },
+	{ "0b101", 1, false }, { "0d12345678901", 1, false }, { "18446744073709551615", 1, false },
+	{ "\"text\"", 5, false }, { "\"esc\\\"aped\\n\"", 3, false }, { "\"\"", 1, false },
+	{ "'a'", 5, false }, { "'\\n'", 2, false }, { "'\\''", 1, false },
+	{ "// note\n", 3, false }, { "/* block\n * comment */", 2, false }, { "/**/", 1, false },
+	{ "18446744073709551616", 1, true }, { "0xFFFFFFFFFFFFFFFFF", 1, true },
+	{ "0x", 1, true }, { "12ab", 1, true }, { "0b102", 1, true }, { "'ab'", 1, true },
+	{ "\"", 1, true }, { "'", 1, true }, { "\\", 1, true }, { "/*", 1, true }, { "*/", 1, true },
+	{ "//", 1, true },
+};
+#define N_FRAGMENTS (sizeof(fragments)/sizeof(*fragments))
+
+struct str_buf check_gen_source(u64 seed, size_t size, char *name, bool with_errors)
+{
+	u32 total_weight = 0;
+	for (size_t i = 0; i < N_FRAGMENTS; ++i)
+		if (with_errors || !fragments[i].error)
+			total_weight += fragments[i].weight;
+
+	check_rng_seed(seed);
+	size_t capacity = size + 64;
+	char *buf = malloc(capacity + 1 + SOURCE_PADDING);
+	if (buf == NULL)
+	{
+		flogf(LOG_ERR, stderr, "failed to allocate generated source with size %zu\n", capacity);
+		exit(3);
+	}
+	size_t len = 0;
+	while (len < size)
+	{
+		u32 pick = check_rng_below(total_weight);
+		size_t i = 0;
+		for (;; ++i)
+		{
+			if (!with_errors && fragments[i].error)
+				continue;
+			if (pick < fragments[i].weight)
+				break;
+			pick -= fragments[i].weight;
+		}
+		size_t frag_len = strlen(fragments[i].text);
+		if (len + frag_len + 1 > capacity)
+			break;
+		memcpy(buf + len, fragments[i].text, frag_len);
+		len += frag_len;
+		// e.g. a number right before an identifier is an invalid literal
+		if (!with_errors)
+			buf[len++] = ' ';
+	}
+	memset(buf + len, '\0', 1 + SOURCE_PADDING);
+	return (struct str_buf) { buf, name, len + 1, capacity };
+}
+
+u32 check_lex(struct str_buf source, u32 options, TokenTable *table)
+{
+	u32 saved_options = lexer_options;
+	lexer_options = options | LEXER_QUIET;
+	Lexer lx;
+	lexer_setup(&lx, source, source.container_filename);
+	lexer_options = saved_options;
+	token_table_init(table, source, source.container_filename);
+	lexer_fill_table(&lx, table);
+	u32 flags = lx.errflags;
+	lexer_cleanup(&lx);
+	return flags;
+}
+
+bool check_same_token(Token a, Token b)
+{
+	return a.type == b.type && a.subtype == b.subtype && a.value.len == b.value.len
+		&& (a.value.len == 0 || memcmp(a.value.buf, b.value.buf, a.value.len) == 0);
+}
+
+void check_print_token(FILE *stream, const char *label, Token token)
+{
+	struct str_buf esc_str = dbg_escape_str(token.value);
+	fprintf(stream, "\t%s{ type: 0x%02X, subtype: 0x%02X, value: \"%.*s\" }\n", label,
+			token.type, token.subtype, (int)esc_str.len, esc_str.buf);
+}
+
+bool check_same_tables(const char *what, const TokenTable *expected, const TokenTable *got)
+{
+	size_t n = MIN(expected->len, got->len);
+	for (size_t i = 0; i < n; ++i)
+	{
+		if (expected->offsets[i] == got->offsets[i] && expected->lengths[i] == got->lengths[i]
+		 && expected->kinds[i] == got->kinds[i])
+			continue;
+		check(false, "%s: token %zu of '%s' differs\n", what, i, expected->source.container_filename);
+		fprintf(stderr, "\tat offsets %u and %u\n", expected->offsets[i], got->offsets[i]);
+		check_print_token(stderr, "expected ", token_table_get(expected, i));
+		check_print_token(stderr, "got      ", token_table_get(got, i));
+		return false;
+	}
+	return check(expected->len == got->len, "%s: '%s' has %zu tokens, expected %zu\n",
+			what, expected->source.container_filename, got->len, expected->len);
+}
+
+void check_write_temp(char path[CHECK_PATH_MAX], const char *buf, size_t len)
+{
+	snprintf(path, CHECK_PATH_MAX, "/tmp/atp-check-XXXXXX");
+	s32 fd = mkstemp(path);
+	if (fd < 0)
+	{
+		flogf(LOG_ERR, stderr, "failed to create a temporary file\n");
+		exit(9);
+	}
+	while (len > 0)
+	{
+		ssize_t n = write(fd, buf, len);
+		if (n <= 0)
+		{
+			flogf(LOG_ERR, stderr, "failed to write '%s'\n", path);
+			exit(9);
+		}
+		buf += n;
+		len -= n;
+	}
+	close(fd);
+}
@@ -0,0 +1,59 @@
+#ifndef CHECK_H
+#define CHECK_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "lexer.h"
+#include "token_table.h"
+#include "types.h"
+#include "util.h"
+
+/* What the check programs (check_*.c, run by `make check`) share. Each one
+ * gets the same tokens out of the same inputs in two ways that have to
+ * agree, e.g. a whole file and the same file streamed in small chunks. The
+ * inputs are random sources generated from fixed seeds, so a failure can be
+ * reproduced, and any files named on the command line.
+ */
+
+/* a check program's lexer options: each is tried with every one of these */
+#define CHECK_N_OPTION_SETS 4
+extern const u32 check_option_sets[CHECK_N_OPTION_SETS];
+
+/* Records a check, printing the message if it failed. Returns `ok`. */
+bool check(bool ok, const char *fmt, ...);
+/* Prints how many checks failed and returns the program's exit code. */
+s32 check_finish(const char *program);
+
+/* splitmix64, the same sequence for the same seed on every machine */
+void check_rng_seed(u64 seed);
+u64 check_rng(void);
+u32 check_rng_below(u32 n);
+
+/* Generates about `size` bytes of lexer input from `seed`: ordinary tokens,
+ * literals and comments, and `with_errors`, unbalanced quotes and comment
+ * markers, stray backslashes and invalid integers mixed in. The buffer is
+ * malloc'd and NUL-terminated and padded like `load_source_file`, whose len
+ * convention (counting the NUL) it also follows.
+ */
+struct str_buf check_gen_source(u64 seed, size_t size, char *name, bool with_errors);
+
+/* Lexes all of `source` with `options` (and LEXER_QUIET) into `table`, which
+ * it initializes. Returns the lexer's error flags.
+ */
+u32 check_lex(struct str_buf source, u32 options, TokenTable *table);
+/* Compares two token tables over the same source text, reporting the first
+ * token that differs. `what` names the pair in the message.
+ */
+bool check_same_tables(const char *what, const TokenTable *expected, const TokenTable *got);
+/* Whether two tokens have the same type, subtype and text. */
+bool check_same_token(Token a, Token b);
+void check_print_token(FILE *stream, const char *label, Token token);
+
+/* Writes `len` bytes to a new temporary file and stores its path, which the
+ * caller unlinks, in `path`.
+ */
+#define CHECK_PATH_MAX 64
+void check_write_temp(char path[CHECK_PATH_MAX], const char *buf, size_t len);
+
+#endif /* CHECK_H */
@@ -0,0 +1,223 @@
+/* Checks what build/lexer does with fatal tokens: it has to report every
+ * diagnostic of a file, not just the first, but print only the tokens before
+ * the first fatal one and exit with 1. Mapped, streamed and token file
+ * output have to agree with each other and with lexing the file here, up to
+ * that token.
+ *   build/check_errors [file]...
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "check.h"
+#include "lexer.h"
+#include "token_file.h"
+#include "token_table.h"
+#include "types.h"
+#include "util.h"
+
+#ifndef CHECK_LEXER
+#define CHECK_LEXER "build/lexer"
+#endif
+
+#define N_REPEATED_LINES 2000
+
+/* sources with a known number of diagnostics, all from fatal literals */
+static const struct { const char *text; size_t n_diags; } sources[] = {
+	{ "x := 3;\n0b2; 12a;\n\n0q1; y;\n", 3 },
+	{ "0b2; 12a; 0q1;", 3 },
+	{ "func f() -> s32 {\n\treturn 0b12;\n}\n", 1 },
+};
+
+/* what one run of build/lexer printed */
+typedef struct {
+	s32 status; /* the exit code, or -1 if it didn't exit */
+	char *out;
+	size_t out_len;
+	struct str_buf err;
+} LexerRun;
+
+static LexerRun run_lexer(const char *path, const char *args)
+{
+	char err_path[CHECK_PATH_MAX];
+	check_write_temp(err_path, NULL, 0);
+	char cmd[512];
+	snprintf(cmd, sizeof(cmd), "%s --no-color --max-diagnostics=0 %s '%s' 2>%s",
+			CHECK_LEXER, args, path, err_path);
+	FILE *pipe = popen(cmd, "r");
+	if (pipe == NULL)
+	{
+		flogf(LOG_ERR, stderr, "failed to run '%s'\n", cmd);
+		exit(2);
+	}
+	LexerRun run = {0};
+	size_t capacity = 0;
+	for (;;)
+	{
+		if (run.out_len == capacity)
+		{
+			capacity = MAX(capacity * 2, 4096);
+			run.out = realloc(run.out, capacity);
+			if (run.out == NULL)
+			{
+				flogf(LOG_ERR, stderr, "failed to reallocate output buffer with size %zu\n", capacity);
+				exit(4);
+			}
+		}
+		size_t n = fread(run.out + run.out_len, 1, capacity - run.out_len, pipe);
+		if (n == 0)
+			break;
+		run.out_len += n;
+	}
+	// the buffer is never full here, so there is room to terminate it
+	run.out[run.out_len] = '\0';
+	s32 status = pclose(pipe);
+	run.status = WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+	run.err = read_file_to_string(err_path);
+	unlink(err_path);
+	return run;
+}
+
+static void free_run(LexerRun *run)
+{
+	free(run->out);
+	free(run->err.buf);
+}
+
+static size_t count_occurrences(const char *text, const char *what)
+{
+	size_t n = 0;
+	for (const char *p = text; (p = strstr(p, what)) != NULL; p += strlen(what))
+		n++;
+	return n;
+}
+
+/* Lexes `src` into `table` like build/lexer does, stopping before the first
+ * fatal token. Returns whether there was one.
+ */
+static bool lex_until_fatal(struct str_buf src, u32 options, TokenTable *table)
+{
+	u32 saved_options = lexer_options;
+	lexer_options = options | LEXER_QUIET;
+	Lexer lx;
+	lexer_setup(&lx, src, src.container_filename);
+	lexer_options = saved_options;
+	token_table_init(table, src, src.container_filename);
+	Token batch[64];
+	size_t n;
+	bool fatal = false;
+	while (!fatal && (n = lexer_next_batch(&lx, batch, sizeof(batch)/sizeof(*batch))) > 0)
+	{
+		// a batch ends with the token that raised an error
+		fatal = lexer_geterr(&lx, INT_LITERAL_HAS_NO_VALID_DIGITS);
+		for (size_t i = 0; i < n - fatal; ++i)
+			token_table_push(table, batch[i]);
+	}
+	lexer_cleanup(&lx);
+	return fatal;
+}
+
+/* Runs build/lexer on the file at `path` in every mode. `n_diags` is how
+ * many diagnostics it has to report, or SIZE_MAX if only the modes have to
+ * agree on it.
+ */
+static void check_file(const char *path, size_t n_diags, u32 options)
+{
+	const char *args = (options & LEXER_COALESCE_LITERALS) ? "--coalesce-literals" : "";
+	char stream_args[64], bin_args[64];
+	snprintf(stream_args, sizeof(stream_args), "%s --stream", args);
+	snprintf(bin_args, sizeof(bin_args), "%s --format=bin --embed-source", args);
+
+	SourceFile file = load_source_file((char *) path);
+	file.contents.container_filename = (char *) path;
+	TokenTable expected;
+	bool fatal = lex_until_fatal(file.contents, options | LEXER_SKIP_COMMENTS, &expected);
+
+	LexerRun mapped = run_lexer(path, args);
+	size_t n_reported = count_occurrences(mapped.err.buf, " --> ");
+	if (n_diags != SIZE_MAX)
+		check(n_reported == n_diags, "'%s' %s: %zu diagnostics, expected %zu\n",
+				path, args, n_reported, n_diags);
+	check(mapped.status == (fatal ? 1 : 0), "'%s' %s: exit status %d, expected %d\n",
+			path, args, mapped.status, fatal ? 1 : 0);
+	size_t n_lines = count_occurrences(mapped.out, " }\n");
+	check(n_lines == expected.len, "'%s' %s: %zu tokens printed, expected %zu\n",
+			path, args, n_lines, expected.len);
+
+	LexerRun streamed = run_lexer(path, stream_args);
+	check(streamed.status == mapped.status, "'%s' %s: exit status %d, %d when mapped\n",
+			path, stream_args, streamed.status, mapped.status);
+	check(streamed.out_len == mapped.out_len && memcmp(streamed.out, mapped.out, mapped.out_len) == 0,
+			"'%s' %s: the tokens differ from the ones printed when mapped\n", path, stream_args);
+	check(strcmp(streamed.err.buf, mapped.err.buf) == 0,
+			"'%s' %s: the diagnostics differ from the ones reported when mapped\n", path, stream_args);
+
+	LexerRun bin = run_lexer(path, bin_args);
+	check(strcmp(bin.err.buf, mapped.err.buf) == 0,
+			"'%s' %s: the diagnostics differ from the ones reported for text\n", path, bin_args);
+	TokenFile tf;
+	if (check(bin.status == mapped.status && token_file_from_buf(&tf, bin.out, bin.out_len),
+			"'%s' %s: exit status %d and no token file\n", path, bin_args, bin.status))
+	{
+		check(tf.files[0].status == mapped.status, "'%s' %s: status %d recorded, expected %d\n",
+				path, bin_args, tf.files[0].status, mapped.status);
+		if (check(tf.files[0].n_tokens == expected.len, "'%s' %s: %llu tokens written, expected %zu\n",
+				path, bin_args, (unsigned long long) tf.files[0].n_tokens, expected.len))
+			for (size_t i = 0; i < expected.len; ++i)
+			{
+				Token got = token_file_token(&tf, 0, i), want = token_table_get(&expected, i);
+				if (!check(check_same_token(got, want), "'%s' %s: token #%zu differs\n", path, bin_args, i))
+				{
+					check_print_token(stderr, "expected: ", want);
+					check_print_token(stderr, "got:      ", got);
+					break;
+				}
+			}
+		token_file_close(&tf);
+	}
+
+	free_run(&mapped);
+	free_run(&streamed);
+	free_run(&bin);
+	token_table_free(&expected);
+	unload_source_file(&file);
+}
+
+static void check_source(const char *text, size_t n_diags)
+{
+	char path[CHECK_PATH_MAX];
+	check_write_temp(path, text, strlen(text));
+	check_file(path, n_diags, 0);
+	check_file(path, n_diags, LEXER_COALESCE_LITERALS);
+	unlink(path);
+}
+
+s32 main(s32 argc, char **argv)
+{
+	for (size_t i = 0; i < sizeof(sources)/sizeof(*sources); ++i)
+		check_source(sources[i].text, sources[i].n_diags);
+
+	// more tokens than fit in one batch, with a fatal literal on every line
+	static const char line[] = "a 0b2;\n";
+	char *text = calloc(N_REPEATED_LINES * (sizeof(line) - 1) + 1, 1);
+	if (text == NULL)
+	{
+		flogf(LOG_ERR, stderr, "failed to allocate generated source\n");
+		exit(3);
+	}
+	for (size_t i = 0; i < N_REPEATED_LINES; ++i)
+		memcpy(text + i * (sizeof(line) - 1), line, sizeof(line) - 1);
+	check_source(text, N_REPEATED_LINES);
+	free(text);
+
+	for (s32 i = 1; i < argc; ++i)
+	{
+		check_file(argv[i], SIZE_MAX, 0);
+		check_file(argv[i], SIZE_MAX, LEXER_COALESCE_LITERALS);
+	}
+	freetmp();
+	return check_finish("check_errors");
+}
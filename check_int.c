@@ -0,0 +1,190 @@
+/* Checks integer literal values: `literal_parse_int` (literal.c), which
+ * parses eight digits at a time, against parsing them one at a time, for
+ * every radix and for lengths around the eight-digit blocks, up to and past
+ * UINT64_MAX; and the values lexed integer literals decode to with
+ * `token_int_value`.
+ *   build/check_int
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "check.h"
+#include "lexer.h"
+#include "literal.h"
+#include "scan.h"
+#include "token_table.h"
+#include "types.h"
+#include "util.h"
+
+#define MAX_DIGITS 80
+
+static const u64 bases[] = {
+	[DIGITS_DEC] = 10,
+	[DIGITS_HEX] = 16,
+	[DIGITS_OCT] = 8,
+	[DIGITS_BIN] = 2,
+};
+static const char *const radix_names[] = {
+	[DIGITS_DEC] = "decimal",
+	[DIGITS_HEX] = "hexadecimal",
+	[DIGITS_OCT] = "octal",
+	[DIGITS_BIN] = "binary",
+};
+
+/* One digit at a time. Returns false if the value doesn't fit in 64 bits. */
+static bool parse_slowly(const char *digits, size_t len, DigitRadix radix, u64 *out)
+{
+	u64 base = bases[radix], value = 0;
+	for (size_t i = 0; i < len; ++i)
+	{
+		char c = digits[i];
+		u64 d = (c >= '0' && c <= '9') ? (u64) (c - '0') : (u64) ((c | 0x20) - 'a' + 10);
+		if (value > (UINT64_MAX - d) / base)
+			return false;
+		value = value * base + d;
+	}
+	*out = value;
+	return true;
+}
+
+static void check_digits(const char *digits, DigitRadix radix)
+{
+	size_t len = strlen(digits);
+	u64 want = 0, got = 0;
+	bool want_ok = parse_slowly(digits, len, radix, &want);
+	bool got_ok = literal_parse_int(digits, len, radix, &got);
+	if (!check(got_ok == want_ok, "%s '%s' %s, expected it to %s\n", radix_names[radix], digits,
+			got_ok ? "fits in 64 bits" : "overflows", want_ok ? "fit" : "overflow"))
+		return;
+	check(!want_ok || got == want, "%s '%s' is %llu, expected %llu\n", radix_names[radix], digits,
+			(unsigned long long) got, (unsigned long long) want);
+}
+
+/* Random digits of every length up to past the longest value, leading zeros
+ * and mixed case included.
+ */
+static void check_random(DigitRadix radix)
+{
+	static const char digit_chars[] = "0123456789abcdefABCDEF";
+	u64 base = bases[radix];
+	char digits[MAX_DIGITS + 1];
+	for (size_t len = 0; len <= MAX_DIGITS; ++len)
+		for (u32 n = 0; n < 40; ++n)
+		{
+			size_t zeros = (n % 4 == 0) ? check_rng_below(len + 1) : 0;
+			for (size_t i = 0; i < len; ++i)
+			{
+				u64 d = (i < zeros) ? 0 : check_rng_below(base);
+				digits[i] = (d >= 10 && check_rng_below(2)) ? digit_chars[d + 6] : digit_chars[d];
+			}
+			digits[len] = '\0';
+			check_digits(digits, radix);
+		}
+}
+
+/* The largest value in every radix, and one more. */
+static void check_limits(void)
+{
+	static const struct { DigitRadix radix; const char *max, *past_max; } limits[] = {
+		{ DIGITS_DEC, "18446744073709551615", "18446744073709551616" },
+		{ DIGITS_HEX, "FFFFFFFFFFFFFFFF", "10000000000000000" },
+		{ DIGITS_HEX, "ffffffffffffffff", "ffffffffffffffff0" },
+		{ DIGITS_OCT, "1777777777777777777777", "2000000000000000000000" },
+		{ DIGITS_BIN, "1111111111111111111111111111111111111111111111111111111111111111",
+			"10000000000000000000000000000000000000000000000000000000000000000" },
+		{ DIGITS_DEC, "000000000000000018446744073709551615", "99999999999999999999" },
+	};
+	for (size_t i = 0; i < sizeof(limits)/sizeof(*limits); ++i)
+	{
+		u64 value = 0;
+		DigitRadix radix = limits[i].radix;
+		check(literal_parse_int(limits[i].max, strlen(limits[i].max), radix, &value) && value == UINT64_MAX,
+				"%s '%s' isn't UINT64_MAX\n", radix_names[radix], limits[i].max);
+		check(!literal_parse_int(limits[i].past_max, strlen(limits[i].past_max), radix, &value),
+				"%s '%s' doesn't overflow\n", radix_names[radix], limits[i].past_max);
+	}
+	// every length around the eight-digit blocks, all digits the largest one
+	for (size_t len = 1; len <= 24; ++len)
+	{
+		char digits[25];
+		memset(digits, '9', len);
+		digits[len] = '\0';
+		check_digits(digits, DIGITS_DEC);
+		memset(digits, 'f', len);
+		check_digits(digits, DIGITS_HEX);
+		memset(digits, '7', len);
+		check_digits(digits, DIGITS_OCT);
+	}
+}
+
+/* Lexed literals decode to their values, ones that overflow don't decode,
+ * and neither do the tokens after them.
+ */
+static void check_lexed(void)
+{
+	static const struct { const char *text; u64 value; bool overflows; } literals[] = {
+		{ "1", 1, false },
+		{ "12345678", 12345678, false },
+		{ "123456789", 123456789, false },
+		{ "0d0042", 42, false },
+		{ "0xDeadBeef", 0xDEADBEEF, false },
+		{ "0o17", 017, false },
+		{ "0b101", 5, false },
+		{ "18446744073709551615", UINT64_MAX, false },
+		{ "0xFFFFFFFFFFFFFFFF", UINT64_MAX, false },
+		{ "18446744073709551616", 0, true },
+		{ "0x10000000000000000", 0, true },
+	};
+	for (size_t i = 0; i < sizeof(literals)/sizeof(*literals); ++i)
+	{
+		size_t len = strlen(literals[i].text);
+		char *buf = calloc(len + 2 + SOURCE_PADDING, 1);
+		if (buf == NULL)
+		{
+			flogf(LOG_ERR, stderr, "failed to allocate generated source with size %zu\n", len);
+			exit(3);
+		}
+		memcpy(buf, literals[i].text, len);
+		buf[len] = ';';
+		for (size_t opt = 0; opt < CHECK_N_OPTION_SETS; ++opt)
+		{
+			TokenTable table;
+			u32 flags = check_lex(strbuflit(buf, len + 2, "literal"), check_option_sets[opt], &table);
+			Token token = token_table_get(&table, 0);
+			if (check(table.len > 0 && token.type == IntegerLiteralToken, "'%s' isn't lexed as an integer literal\n",
+					literals[i].text))
+			{
+				u64 value = 0;
+				bool fits = token_int_value(token, &value);
+				check(fits == !literals[i].overflows, "'%s' %s, expected it to %s\n", literals[i].text,
+						fits ? "decodes" : "doesn't decode", literals[i].overflows ? "overflow" : "decode");
+				check(!fits || value == literals[i].value, "'%s' has the value %llu, expected %llu\n",
+						literals[i].text, (unsigned long long) value, (unsigned long long) literals[i].value);
+			}
+			check(((flags & (1 << INT_LITERAL_OVERFLOW)) != 0) == literals[i].overflows,
+					"'%s' %s INT_LITERAL_OVERFLOW\n", literals[i].text,
+					literals[i].overflows ? "doesn't raise" : "raises");
+			for (size_t j = 1; j < table.len; ++j)
+			{
+				u64 value;
+				check(!token_int_value(token_table_get(&table, j), &value),
+						"token %zu after '%s' decodes to %llu\n", j, literals[i].text, (unsigned long long) value);
+			}
+			token_table_free(&table);
+		}
+		free(buf);
+	}
+}
+
+s32 main(void)
+{
+	check_rng_seed(1);
+	for (DigitRadix radix = DIGITS_DEC; radix <= DIGITS_BIN; ++radix)
+		check_random(radix);
+	check_limits();
+	check_lexed();
+	freetmp();
+	return check_finish("check_int");
+}
@@ -0,0 +1,111 @@
+/* Checks parallel lexing (lex_parallel.c) against serial lexing: with every
+ * option set and any number of chunks, the tokens have to be the same, and
+ * it has to fail exactly when serial lexing raises an error. On input where
+ * every line ends outside of a literal (char literals included), every
+ * chunk's speculative tokens have to be kept rather than lexed again.
+ *   build/check_parallel [file]...
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "check.h"
+#include "lex_parallel.h"
+#include "lexer.h"
+#include "token_table.h"
+#include "types.h"
+#include "util.h"
+
+static LexParallelInfo check_parallel(struct str_buf source, u32 options, u32 n_threads)
+{
+	const char *name = source.container_filename;
+	TokenTable serial, parallel;
+	bool serial_ok = (check_lex(source, options, &serial) == 0);
+
+	u32 saved_options = lexer_options;
+	lexer_options = options | LEXER_QUIET;
+	token_table_init(&parallel, source, source.container_filename);
+	LexParallelInfo info;
+	bool parallel_ok = lex_parallel(source, source.container_filename, n_threads, &parallel, &info);
+	lexer_options = saved_options;
+
+	if (check(parallel_ok == serial_ok, "parallel lexing of '%s' (options 0x%X, %u threads) %s,"
+			" serial lexing %s\n", name, options, n_threads, parallel_ok ? "succeeded" : "failed",
+			serial_ok ? "succeeded" : "failed") && parallel_ok)
+	{
+		char what[64];
+		snprintf(what, sizeof(what), "parallel (options 0x%X, %u threads) vs serial", options, n_threads);
+		check_same_tables(what, &serial, &parallel);
+	}
+	token_table_free(&serial);
+	token_table_free(&parallel);
+	return info;
+}
+
+/* Lines of declarations with char and string literals, each of them ending
+ * outside of any literal.
+ */
+static struct str_buf gen_literal_lines(size_t size, char *name)
+{
+	static const char *const lines[] = {
+		"c := 'x'; d := '\\n'; e := '\\'';\n",
+		"s := \"text\"; t := '\"';\n",
+		"\tf('a', 'b', \"c\\\"d\");\n",
+		"// a comment\n",
+	};
+	char *buf = malloc(size + 64 + 1 + SOURCE_PADDING);
+	if (buf == NULL)
+	{
+		flogf(LOG_ERR, stderr, "failed to allocate generated source with size %zu\n", size);
+		exit(3);
+	}
+	size_t len = 0;
+	for (size_t i = 0; len < size; ++i)
+	{
+		const char *line = lines[i % (sizeof(lines)/sizeof(*lines))];
+		memcpy(buf + len, line, strlen(line));
+		len += strlen(line);
+	}
+	memset(buf + len, '\0', 1 + SOURCE_PADDING);
+	return (struct str_buf) { buf, name, len + 1, size + 64 };
+}
+
+s32 main(s32 argc, char **argv)
+{
+	const u32 thread_counts[] = { 1, 2, 7, 29 };
+	for (u64 seed = 1; seed <= 6; ++seed)
+	{
+		// half of them without errors, so the tokens get compared
+		char name[32];
+		bool with_errors = (seed % 2 == 0);
+		snprintf(name, sizeof(name), "generated-%llu%s", (unsigned long long) seed,
+				with_errors ? "-errors" : "");
+		struct str_buf src = check_gen_source(seed, 40000 * seed, name, with_errors);
+		for (size_t opt = 0; opt < CHECK_N_OPTION_SETS; ++opt)
+			for (size_t t = 0; t < sizeof(thread_counts)/sizeof(*thread_counts); ++t)
+				check_parallel(src, check_option_sets[opt], thread_counts[t]);
+		free(src.buf);
+	}
+
+	struct str_buf lines = gen_literal_lines(256 << 10, "literal-lines");
+	for (size_t opt = 0; opt < CHECK_N_OPTION_SETS; ++opt)
+	{
+		LexParallelInfo info = check_parallel(lines, check_option_sets[opt], 16);
+		check(info.n_speculated + 1 == info.n_chunks, "parallel lexing of '%s' (options 0x%X) kept"
+				" %zu of %zu speculative chunks\n", lines.container_filename, check_option_sets[opt],
+				info.n_speculated, info.n_chunks - 1);
+	}
+	free(lines.buf);
+
+	for (s32 i = 1; i < argc; ++i)
+	{
+		SourceFile file = load_source_file(argv[i]);
+		file.contents.container_filename = argv[i];
+		for (size_t opt = 0; opt < CHECK_N_OPTION_SETS; ++opt)
+			for (size_t t = 0; t < sizeof(thread_counts)/sizeof(*thread_counts); ++t)
+				check_parallel(file.contents, check_option_sets[opt], thread_counts[t]);
+		unload_source_file(&file);
+	}
+	freetmp();
+	return check_finish("check_parallel");
+}
@@ -0,0 +1,159 @@
+/* Checks incremental re-lexing (relex.c) against lexing the edited source
+ * from scratch: after every one of a series of random edits, with every
+ * option set, the tokens have to be the same, and the ones `relex_edit`
+ * says it kept have to be the old ones. Editing a file of short statements
+ * has to re-lex only a few tokens, char literals included.
+ *   build/check_relex [file]...
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "check.h"
+#include "lexer.h"
+#include "relex.h"
+#include "token_table.h"
+#include "types.h"
+#include "util.h"
+
+#define N_EDITS 150
+
+/* what random edits insert */
+static const char *const insertions[] = {
+	"", "", " ", "\n", "x", "abc def", "func", "12", "0x1F", "0b", "x := 3;", "->", "...",
+	"{", "}", ";", "\"", "'", "\\", "/*", "*/", "//", "\"hi\\n\"", "'a'", "'\\n'", "c := 'a'; ",
+};
+#define N_INSERTIONS (sizeof(insertions)/sizeof(*insertions))
+
+static RelexRange edit_and_relex(const TokenTable *old, SourceEdit edit, u32 options, TokenTable *out)
+{
+	u32 saved_options = lexer_options;
+	lexer_options = options;
+	RelexRange range = relex_edit(old, edit, out);
+	lexer_options = saved_options;
+	return range;
+}
+
+/* Whether `range` describes `got` as `old` with only tokens [first, end)
+ * replaced.
+ */
+static bool check_range(const char *name, const TokenTable *old, const TokenTable *got, RelexRange range, s64 shift)
+{
+	if (!check(range.first <= range.old_end && range.first <= range.new_end && range.new_end <= got->len
+	 && range.old_end <= old->len && old->len - range.old_end == got->len - range.new_end,
+			"relex_edit of '%s' returned a bad range\n", name))
+		return false;
+	for (size_t i = 0; i < range.first; ++i)
+		if (old->offsets[i] != got->offsets[i] || old->lengths[i] != got->lengths[i] || old->kinds[i] != got->kinds[i])
+			return check(false, "relex_edit of '%s' changed token %zu before its range\n", name, i);
+	for (size_t i = range.old_end; i < old->len; ++i)
+	{
+		size_t j = i - range.old_end + range.new_end;
+		if (old->offsets[i] + shift != got->offsets[j] || old->lengths[i] != got->lengths[j]
+		 || old->kinds[i] != got->kinds[j])
+			return check(false, "relex_edit of '%s' changed token %zu after its range\n", name, i);
+	}
+	return true;
+}
+
+static void check_edits(struct str_buf source, u32 options, u64 seed)
+{
+	const char *name = source.container_filename;
+	TokenTable cur;
+	check_lex(source, options, &cur);
+	check_rng_seed(seed);
+	for (u32 n = 0; n < N_EDITS; ++n)
+	{
+		size_t len = cur.source.len - 1;
+		SourceEdit edit = { .offset = check_rng_below(len + 1) };
+		edit.deleted = check_rng_below(MIN(len - edit.offset, 8) + 1);
+		const char *inserted = insertions[check_rng_below(N_INSERTIONS)];
+		edit.inserted = strbuflit((char *) inserted, strlen(inserted), NULL);
+
+		TokenTable next, expected;
+		RelexRange range = edit_and_relex(&cur, edit, options, &next);
+		check_lex(next.source, options, &expected);
+		char what[96];
+		snprintf(what, sizeof(what), "edit %u (options 0x%X, -%zu +\"%s\" at %zu) vs full lexing",
+				n, options, edit.deleted, inserted, edit.offset);
+		bool ok = check_same_tables(what, &expected, &next)
+			&& check_range(name, &cur, &next, range, (s64) edit.inserted.len - (s64) edit.deleted);
+		token_table_free(&expected);
+		if (n == 0)
+			token_table_free(&cur);
+		else
+			relex_free(&cur);
+		cur = next;
+		if (!ok)
+			break;
+	}
+	relex_free(&cur);
+}
+
+/* Lines of `x := 1;`, where an edit can't reach more than a few tokens. */
+static void check_reuse(u32 options)
+{
+	static const char line[] = "x := 1;\n";
+	size_t n_lines = 25000, len = n_lines * (sizeof(line) - 1);
+	char *buf = malloc(len + 1 + SOURCE_PADDING);
+	if (buf == NULL)
+	{
+		flogf(LOG_ERR, stderr, "failed to allocate generated source with size %zu\n", len);
+		exit(3);
+	}
+	for (size_t i = 0; i < n_lines; ++i)
+		memcpy(buf + i * (sizeof(line) - 1), line, sizeof(line) - 1);
+	memset(buf + len, '\0', 1 + SOURCE_PADDING);
+	TokenTable cur;
+	check_lex(strbuflit(buf, len + 1, "statements"), options, &cur);
+
+	// a char literal, another statement after it and the literal removed again
+	static const char char_decl[] = "c := 'a'; ";
+	size_t at = len / 2 / (sizeof(line) - 1) * (sizeof(line) - 1);
+	SourceEdit edits[] = {
+		{ at, 0, strbuflit((char *) char_decl, sizeof(char_decl) - 1, NULL) },
+		{ at + 800, 0, strbuflit((char *) char_decl, sizeof(char_decl) - 1, NULL) },
+		{ at, sizeof(char_decl) - 1, strbuflit((char *) "", 0, NULL) },
+	};
+	for (size_t i = 0; i < sizeof(edits)/sizeof(*edits); ++i)
+	{
+		TokenTable next;
+		RelexRange range = edit_and_relex(&cur, edits[i], options, &next);
+		check(range.new_end - range.first <= 16 && range.old_end - range.first <= 16,
+				"edit %zu of 'statements' (options 0x%X) re-lexed %zu tokens for %zu\n",
+				i, options, range.new_end - range.first, range.old_end - range.first);
+		if (i == 0)
+			token_table_free(&cur);
+		else
+			relex_free(&cur);
+		cur = next;
+	}
+	relex_free(&cur);
+	free(buf);
+}
+
+s32 main(s32 argc, char **argv)
+{
+	for (u64 seed = 1; seed <= 4; ++seed)
+	{
+		char name[32];
+		snprintf(name, sizeof(name), "generated-%llu", (unsigned long long) seed);
+		struct str_buf src = check_gen_source(seed, 3000 * seed, name, seed % 2 == 0);
+		for (size_t opt = 0; opt < CHECK_N_OPTION_SETS; ++opt)
+			check_edits(src, check_option_sets[opt], seed * CHECK_N_OPTION_SETS + opt);
+		free(src.buf);
+	}
+	for (size_t opt = 0; opt < CHECK_N_OPTION_SETS; ++opt)
+		check_reuse(check_option_sets[opt]);
+
+	for (s32 i = 1; i < argc; ++i)
+	{
+		SourceFile file = load_source_file(argv[i]);
+		file.contents.container_filename = argv[i];
+		for (size_t opt = 0; opt < CHECK_N_OPTION_SETS; ++opt)
+			check_edits(file.contents, check_option_sets[opt], i * CHECK_N_OPTION_SETS + opt);
+		unload_source_file(&file);
+	}
+	freetmp();
+	return check_finish("check_relex");
+}
@@ -0,0 +1,124 @@
+/* Checks `load_source_file` (util.c): a file that is mapped and the same
+ * bytes read from a pipe have to come out the same, NUL-terminated and
+ * followed by SOURCE_PADDING zero bytes, and lex to the same tokens. The
+ * sizes tried are around page boundaries, where the padding has to come from
+ * the anonymous mapping the file is mapped over.
+ *   build/check_source [file]...
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "check.h"
+#include "lexer.h"
+#include "token_table.h"
+#include "types.h"
+#include "util.h"
+
+static bool padded(SourceFile *file)
+{
+	for (size_t i = file->contents.len - 1; i < file->contents.len + SOURCE_PADDING; ++i)
+		if (file->contents.buf[i] != '\0')
+			return false;
+	return true;
+}
+
+/* Loads what a child process writes into a pipe, which isn't mapped. */
+static SourceFile load_through_pipe(const char *buf, size_t len)
+{
+	s32 fds[2];
+	if (pipe(fds) < 0)
+	{
+		flogf(LOG_ERR, stderr, "failed to create a pipe\n");
+		exit(1);
+	}
+	pid_t pid = fork();
+	if (pid == 0)
+	{
+		close(fds[0]);
+		while (len > 0)
+		{
+			ssize_t n = write(fds[1], buf, len);
+			if (n <= 0)
+				_exit(9);
+			buf += n;
+			len -= n;
+		}
+		_exit(0);
+	}
+	close(fds[1]);
+	char path[CHECK_PATH_MAX];
+	snprintf(path, sizeof(path), "/dev/fd/%d", fds[0]);
+	SourceFile file = load_source_file(path);
+	close(fds[0]);
+	waitpid(pid, NULL, 0);
+	return file;
+}
+
+static void check_source(const char *name, const char *buf, size_t len)
+{
+	char path[CHECK_PATH_MAX];
+	check_write_temp(path, buf, len);
+	SourceFile mapped = load_source_file(path);
+	unlink(path);
+	SourceFile piped = load_through_pipe(buf, len);
+
+	check(mapped.map_size != 0 || len == 0, "'%s' (%zu bytes) wasn't mapped\n", name, len);
+	check(piped.map_size == 0, "'%s' read from a pipe claims to be mapped\n", name);
+	SourceFile *files[] = { &mapped, &piped };
+	for (size_t i = 0; i < 2; ++i)
+	{
+		SourceFile *file = files[i];
+		const char *how = (i == 0) ? "mapped" : "piped";
+		if (!check(file->contents.len == len + 1, "%s '%s' has length %zu, expected %zu\n",
+				how, name, file->contents.len, len + 1))
+			continue;
+		check(memcmp(file->contents.buf, buf, len) == 0, "%s '%s' has other contents\n", how, name);
+		check(padded(file), "%s '%s' isn't followed by a NUL and zero padding\n", how, name);
+	}
+
+	if (mapped.contents.len == len + 1 && piped.contents.len == len + 1)
+	{
+		mapped.contents.container_filename = piped.contents.container_filename = (char *)name;
+		TokenTable from_map, from_pipe;
+		check_lex(mapped.contents, 0, &from_map);
+		check_lex(piped.contents, 0, &from_pipe);
+		check_same_tables("mapped vs piped", &from_map, &from_pipe);
+		token_table_free(&from_map);
+		token_table_free(&from_pipe);
+	}
+	unload_source_file(&mapped);
+	unload_source_file(&piped);
+}
+
+s32 main(s32 argc, char **argv)
+{
+	size_t page_size = sysconf(_SC_PAGESIZE);
+	size_t sizes[] = {
+		0, 1, 100,
+		page_size - 1 - SOURCE_PADDING, page_size - SOURCE_PADDING,
+		page_size - 1, page_size, page_size + 1,
+		3 * page_size - 10,
+		(2 << 20) + 123,
+	};
+	for (size_t i = 0; i < sizeof(sizes)/sizeof(*sizes); ++i)
+	{
+		char name[32];
+		snprintf(name, sizeof(name), "generated-%zu", sizes[i]);
+		// generated sources only stop after a whole fragment, so cut them to size
+		struct str_buf src = check_gen_source(i + 1, sizes[i], name, true);
+		check_source(name, src.buf, sizes[i]);
+		free(src.buf);
+	}
+
+	for (s32 i = 1; i < argc; ++i)
+	{
+		struct str_buf contents = read_file_to_string(argv[i]);
+		check_source(argv[i], contents.buf, contents.len - 1);
+		free(contents.buf);
+	}
+	freetmp();
+	return check_finish("check_source");
+}
@@ -0,0 +1,102 @@
+/* Checks the streaming lexer (lexer_stream.c) against lexing the whole
+ * input at once: with every option set, the tokens and error flags have to
+ * be the same. It is built with a LEXER_STREAM_CHUNK shorter than
+ * LEXER_STREAM_LOOKAHEAD, so tokens are cut off by chunk boundaries all the
+ * time.
+ *   build/check_stream [file]...
+ */
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "check.h"
+#include "lexer.h"
+#include "lexer_stream.h"
+#include "token_table.h"
+#include "types.h"
+#include "util.h"
+
+static void check_stream(struct str_buf source, u32 options)
+{
+	const char *name = source.container_filename;
+	TokenTable expected;
+	u32 expected_flags = check_lex(source, options, &expected);
+
+	char path[CHECK_PATH_MAX];
+	check_write_temp(path, source.buf, source.len - 1);
+	s32 fd = open(path, O_RDONLY);
+	unlink(path);
+	if (fd < 0)
+	{
+		flogf(LOG_ERR, stderr, "failed to open file '%s'\n", path);
+		exit(2);
+	}
+	u32 saved_options = lexer_options;
+	lexer_options = options | LEXER_QUIET;
+	LexerStream ls;
+	lexer_stream_open(&ls, fd, (char *)name);
+	lexer_options = saved_options;
+
+	Token batch[64];
+	size_t n, n_tokens = 0;
+	bool same = true;
+	while (same && (n = lexer_stream_next_batch(&ls, batch, sizeof(batch)/sizeof(*batch))) > 0)
+	{
+		// the chunk starts this far into the input
+		size_t chunk_offset = ls.n_read - ls.len;
+		for (size_t i = 0; same && i < n; ++i, ++n_tokens)
+		{
+			if (n_tokens >= expected.len)
+			{
+				same = check(false, "stream of '%s' (options 0x%X) has more than %zu tokens\n",
+						name, options, expected.len);
+				break;
+			}
+			Token want = token_table_get(&expected, n_tokens);
+			size_t offset = chunk_offset + (batch[i].value.buf - ls.buf);
+			if (check_same_token(want, batch[i]) && (batch[i].value.len == 0 || offset == expected.offsets[n_tokens]))
+				continue;
+			same = check(false, "stream of '%s' (options 0x%X) differs at token %zu\n",
+					name, options, n_tokens);
+			check_print_token(stderr, "expected ", want);
+			check_print_token(stderr, "got      ", batch[i]);
+		}
+	}
+	if (same)
+	{
+		check(n_tokens == expected.len, "stream of '%s' (options 0x%X) has %zu tokens, expected %zu\n",
+				name, options, n_tokens, expected.len);
+		check(ls.lx.errflags == expected_flags, "stream of '%s' (options 0x%X) raised errors 0x%X, expected 0x%X\n",
+				name, options, ls.lx.errflags, expected_flags);
+	}
+	lexer_stream_close(&ls);
+	close(fd);
+	token_table_free(&expected);
+}
+
+s32 main(s32 argc, char **argv)
+{
+	size_t sizes[] = { 0, 1, 40, 1000, 50000, 300000 };
+	for (size_t i = 0; i < sizeof(sizes)/sizeof(*sizes); ++i)
+	{
+		char name[32];
+		snprintf(name, sizeof(name), "generated-%zu", sizes[i]);
+		struct str_buf src = check_gen_source(i + 1, sizes[i], name, true);
+		for (size_t opt = 0; opt < CHECK_N_OPTION_SETS; ++opt)
+			check_stream(src, check_option_sets[opt]);
+		free(src.buf);
+	}
+
+	for (s32 i = 1; i < argc; ++i)
+	{
+		SourceFile file = load_source_file(argv[i]);
+		file.contents.container_filename = argv[i];
+		for (size_t opt = 0; opt < CHECK_N_OPTION_SETS; ++opt)
+			check_stream(file.contents, check_option_sets[opt]);
+		unload_source_file(&file);
+	}
+	freetmp();
+	return check_finish("check_stream");
+}
@@ -0,0 +1,201 @@
+/* Checks token files (token_file.c) by writing token tables out, mapping the
+ * file again and comparing what the reader rebuilds with the tables: names,
+ * statuses, sources and every token, with and without embedded sources.
+ *   build/check_token_file [file]...
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "check.h"
+#include "lexer.h"
+#include "token_file.h"
+#include "token_table.h"
+#include "types.h"
+#include "util.h"
+
+#define MAX_INPUTS 16
+
+static void check_tokens(const TokenFile *tf, u32 file, const TokenTable *table, bool embedded)
+{
+	const char *name = table->source.container_filename;
+	size_t n_tokens;
+	token_file_tokens(tf, file, &n_tokens);
+	if (!check(n_tokens == table->len, "token file has %zu tokens for '%s', expected %zu\n",
+			n_tokens, name, table->len))
+		return;
+	for (size_t i = 0; i < n_tokens; ++i)
+	{
+		Token want = token_table_get(table, i);
+		Token got = token_file_token(tf, file, i);
+		bool same = (got.type == want.type && got.subtype == want.subtype && got.value.len == want.value.len);
+		if (embedded)
+			same = same && got.value.buf - token_file_source(tf, file).buf == table->offsets[i]
+				&& check_same_token(want, got);
+		else
+			same = same && got.value.buf == NULL;
+		if (same)
+			continue;
+		check(false, "token %zu of '%s' differs in the token file\n", i, name);
+		check_print_token(stderr, "expected ", want);
+		if (got.value.buf != NULL)
+			check_print_token(stderr, "got      ", got);
+		return;
+	}
+	// every token that starts at or after an offset is the one found for it
+	for (size_t i = 0; i < n_tokens; i += 1 + i / 8)
+	{
+		u32 offset = table->offsets[i];
+		size_t found = token_file_find(tf, file, offset);
+		size_t want = i;
+		while (want > 0 && (u64) table->offsets[want-1] + table->lengths[want-1] > offset)
+			want--;
+		while (want < n_tokens && (u64) table->offsets[want] + table->lengths[want] <= offset)
+			want++;
+		if (!check(found == want, "token_file_find('%s', %u) is %zu, expected %zu\n", name, offset, found, want))
+			return;
+	}
+}
+
+static void check_round_trip(const TokenTable *tables, u32 n_files, bool embed_source)
+{
+	TokenFileInput inputs[MAX_INPUTS];
+	for (u32 i = 0; i < n_files; ++i)
+		inputs[i] = (TokenFileInput) { tables[i].source.container_filename, &tables[i], (s32) i % 3 };
+
+	char path[CHECK_PATH_MAX];
+	check_write_temp(path, NULL, 0);
+	FILE *out = fopen(path, "wb");
+	if (out == NULL)
+	{
+		flogf(LOG_ERR, stderr, "failed to open file '%s'\n", path);
+		exit(2);
+	}
+	check(token_file_write(out, inputs, n_files, embed_source), "failed to write token file '%s'\n", path);
+	fclose(out);
+
+	TokenFile tf;
+	bool opened = token_file_open(&tf, path);
+	unlink(path);
+	if (!check(opened, "failed to open the token file just written\n")
+	 || !check(tf.header->n_files == n_files, "token file has %u files, expected %u\n",
+			tf.header->n_files, n_files))
+		return;
+	for (u32 i = 0; i < n_files; ++i)
+	{
+		const char *name = tables[i].source.container_filename;
+		check(strcmp(token_file_name(&tf, i), name) == 0, "file %u of the token file is '%s', expected '%s'\n",
+				i, token_file_name(&tf, i), name);
+		check(tf.files[i].status == inputs[i].status, "'%s' has status %d in the token file, expected %d\n",
+				name, tf.files[i].status, inputs[i].status);
+		struct str_buf source = token_file_source(&tf, i);
+		if (embed_source)
+			check(source.len == tables[i].source.len
+				&& memcmp(source.buf, tables[i].source.buf, source.len) == 0,
+				"the source of '%s' embedded in the token file differs\n", name);
+		else
+			check(source.buf == NULL, "token file has a source for '%s' that wasn't embedded\n", name);
+		check_tokens(&tf, i, &tables[i], embed_source);
+	}
+	token_file_close(&tf);
+}
+
+/* A record pointing past its source or holding a kind no lexer produces, as
+ * in a damaged file, is only noticed when its token is rebuilt.
+ */
+static void check_bad_record(const TokenTable *table)
+{
+	if (table->len == 0)
+		return;
+	char path[CHECK_PATH_MAX];
+	check_write_temp(path, NULL, 0);
+	FILE *out = fopen(path, "wb");
+	TokenFileInput input = { table->source.container_filename, table, 0 };
+	bool written = (out != NULL && token_file_write(out, &input, 1, true));
+	if (out != NULL)
+		fclose(out);
+	struct str_buf contents = read_file_to_string(path);
+	unlink(path);
+	if (!check(written, "failed to write token file '%s'\n", path))
+	{
+		free(contents.buf);
+		return;
+	}
+
+	// read_file_to_string's buffer is malloc'd, so suitably aligned
+	size_t size = contents.len - 1;
+	TokenFile tf;
+	if (!check(token_file_from_buf(&tf, contents.buf, size), "failed to read back a token file\n"))
+	{
+		free(contents.buf);
+		return;
+	}
+	TokenRecord *records = (TokenRecord *) (contents.buf + tf.files[0].tokens_offset);
+	records[0].offset = tf.files[0].source_len;
+	records[0].length = 1;
+	check(token_file_from_buf(&tf, contents.buf, size), "a bad token record keeps the token file from opening\n");
+	Token token = token_file_token(&tf, 0, 0);
+	check(token.value.buf == NULL && token.value.len == 1,
+			"a token outside of its source was rebuilt with a value\n");
+
+	// kinds out of range, in a gap of the enum, or not matching each other
+	static const u8 bad_kinds[][2] = {
+		{ FileEndToken + 1, NOT_IDENTIFIER }, { 0xFF, NOT_IDENTIFIER }, { 0x05, NOT_IDENTIFIER },
+		{ OperatorToken, BIN_INT_LITERAL + 1 }, { OperatorToken, 0xFF }, { OperatorToken, 0x07 },
+		{ IdentifierToken, DEC_INT_LITERAL }, { IntegerLiteralToken, FUNC_KEYWORD },
+	};
+	for (size_t i = 0; i < sizeof(bad_kinds)/sizeof(*bad_kinds) && tf.files[0].n_tokens > 1; ++i)
+	{
+		records[1].type = bad_kinds[i][0];
+		records[1].subtype = bad_kinds[i][1];
+		token = token_file_token(&tf, 0, 1);
+		check(token.type == MiscToken && token.subtype == ERROR_TOKEN && token.value.buf == NULL,
+				"a record of type 0x%02X and subtype 0x%02X was rebuilt as a token of type 0x%02X\n",
+				bad_kinds[i][0], bad_kinds[i][1], token.type);
+	}
+	token_file_close(&tf);
+	free(contents.buf);
+}
+
+s32 main(s32 argc, char **argv)
+{
+	struct str_buf sources[MAX_INPUTS];
+	u32 n_sources = 0;
+	size_t sizes[] = { 0, 1, 2000, 100000 };
+	char names[4][32];
+	for (size_t i = 0; i < sizeof(sizes)/sizeof(*sizes); ++i)
+	{
+		snprintf(names[i], sizeof(names[i]), "generated-%zu", sizes[i]);
+		sources[n_sources++] = check_gen_source(i + 1, sizes[i], names[i], true);
+	}
+	SourceFile files[MAX_INPUTS];
+	u32 n_files = 0;
+	for (s32 i = 1; i < argc && n_sources < MAX_INPUTS; ++i)
+	{
+		files[n_files] = load_source_file(argv[i]);
+		files[n_files].contents.container_filename = argv[i];
+		sources[n_sources++] = files[n_files++].contents;
+	}
+
+	for (size_t opt = 0; opt < CHECK_N_OPTION_SETS; ++opt)
+	{
+		TokenTable tables[MAX_INPUTS];
+		for (u32 i = 0; i < n_sources; ++i)
+			check_lex(sources[i], check_option_sets[opt], &tables[i]);
+		check_round_trip(tables, n_sources, true);
+		check_round_trip(tables, n_sources, false);
+		check_round_trip(tables, 0, false);
+		if (opt == 0)
+			check_bad_record(&tables[n_sources-1]);
+		for (u32 i = 0; i < n_sources; ++i)
+			token_table_free(&tables[i]);
+	}
+
+	for (size_t i = 0; i < sizeof(sizes)/sizeof(*sizes); ++i)
+		free(sources[i].buf);
+	for (u32 i = 0; i < n_files; ++i)
+		unload_source_file(&files[i]);
+	freetmp();
+	return check_finish("check_token_file");
+}
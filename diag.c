@@ -0,0 +1,124 @@
+#include "diag.h"
+
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+#include "line_index.h"
+#include "types.h"
+#include "util.h"
+
+void diag_push(DiagList *list, Diag diag)
+{
+	if (list->len == list->capacity)
+	{
+		size_t new_cap = MAX(list->capacity * 2, 64);
+		if (list->arena != NULL)
+			list->items = arena_realloc(list->arena, list->items,
+					list->capacity * sizeof(Diag), new_cap * sizeof(Diag));
+		else
+		{
+			Diag *new_items = realloc(list->items, new_cap * sizeof(Diag));
+			if (new_items == NULL)
+			{
+				flogf(LOG_ERR, stderr, "failed to reallocate diagnostic list with size %zu\n",
+						new_cap * sizeof(Diag));
+				exit(4);
+			}
+			list->items = new_items;
+		}
+		list->capacity = new_cap;
+	}
+	list->items[list->len++] = diag;
+}
+
+static int cmp_diags(const void *a, const void *b)
+{
+	const Diag *da = a, *db = b;
+	if (da->offset != db->offset)
+		return (da->offset < db->offset) ? -1 : 1;
+	if (da->kind != db->kind)
+		return (da->kind < db->kind) ? -1 : 1;
+	if (da->len != db->len)
+		return (da->len < db->len) ? -1 : 1;
+	return 0;
+}
+
+static bool same_diag(const Diag *a, const Diag *b)
+{
+	return a->offset == b->offset && a->len == b->len && a->kind == b->kind && a->arg == b->arg;
+}
+
+static u8 severity_color(u8 severity)
+{
+	switch (severity) {
+	case LOG_ERR: return ERR_COLOR;
+	case LOG_WARN: return WARN_COLOR;
+	case LOG_INFO: return INFO_COLOR;
+	default: return DEBUG_COLOR;
+	}
+}
+
+/* Passes the arguments on to `vdebug_print_line`. */
+static void print_line(FILE *stream, struct str_buf substr, char *line_start, char *line_end,
+		size_t line_n, u8 color, LOG_TYPE log_type, const char *msg_fmt, ...)
+{
+	va_list arg_list;
+	va_start(arg_list, msg_fmt);
+	vdebug_print_line(stream, substr, line_start, line_end, line_n, color, color, log_type,
+			msg_fmt, arg_list);
+	va_end(arg_list);
+}
+
+void diag_report(DiagList *list, FILE *stream, const DiagSource *src, bool last)
+{
+	if (list->len == 0 && !(last && list->n_omitted > 0))
+		return;
+	// diagnostics are mostly recorded in order already, but not always (e.g.
+	// an unterminated char literal is reported once the literal runs long)
+	qsort(list->items, list->len, sizeof(Diag), cmp_diags);
+
+	// rendered in memory and written at once, rather than a few bytes at a time
+	// to an unbuffered stderr
+	char *buf = NULL;
+	size_t buf_len = 0;
+	FILE *out = open_memstream(&buf, &buf_len);
+	if (out == NULL)
+		out = stream;
+	for (size_t i = 0; i < list->len; ++i)
+	{
+		const Diag *d = &list->items[i];
+		if (i > 0 && same_diag(d, &list->items[i-1]))
+			continue;
+		if (src->max_reported != 0 && list->n_reported >= src->max_reported)
+		{
+			list->n_omitted++;
+			continue;
+		}
+		list->n_reported++;
+		size_t line = line_index_find(src->lines, d->offset);
+		size_t line_n = (d->line != 0) ? d->line : src->line_base + line + 1;
+		print_line(out, strbuflit(src->source.buf + d->offset, d->len, src->source.container_filename),
+				src->source.buf + line_index_start(src->lines, line),
+				src->source.buf + line_index_end(src->lines, line), line_n,
+				severity_color(d->severity), d->severity, src->messages[d->kind], d->arg, d->arg);
+	}
+	if (last && list->n_omitted > 0)
+		flogf(LOG_WARN, out, "%zu more diagnostics for '%s' not shown (see --max-diagnostics)\n",
+				list->n_omitted, src->source.container_filename);
+	list->len = 0;
+	if (out == stream)
+		return;
+	fclose(out);
+	fwrite(buf, 1, buf_len, stream);
+	free(buf);
+}
+
+void diag_list_free(DiagList *list)
+{
+	Arena *arena = list->arena;
+	if (arena == NULL)
+		free(list->items);
+	*list = (DiagList) { .arena = arena };
+}
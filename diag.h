@@ -0,0 +1,53 @@
+#ifndef DIAG_H
+#define DIAG_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+#include "arena.h"
+#include "line_index.h"
+#include "types.h"
+#include "util.h"
+
+/* Diagnostics recorded while lexing and reported afterwards, so that a file
+ * with thousands of bad literals costs an append per diagnostic rather than
+ * a round of unbuffered writes. A report sorts what was recorded by
+ * position, drops repeats, stops at a limit, and renders the rest into one
+ * buffer that is written out at once.
+ */
+
+typedef struct {
+	size_t offset; /* of the span in the source */
+	u32 len;
+	u16 kind; /* the message, an index into `DiagSource.messages` */
+	u8 severity; /* a LOG_TYPE */
+	const char *arg; /* a static string for every "%s" of the message, or NULL */
+	size_t line; /* 1-based, or 0 to look it up when reporting */
+} Diag;
+
+typedef struct {
+	Diag *items;
+	size_t len, capacity;
+	size_t n_reported, n_omitted; /* over every report so far */
+	Arena *arena; /* where `items` is allocated, or NULL for malloc */
+} DiagList;
+
+/* what a report needs to render the diagnostics of a list */
+typedef struct {
+	struct str_buf source; /* the text the offsets are into, named by container_filename */
+	const LineIndex *lines; /* of `source` */
+	size_t line_base; /* lines before `source`, e.g. in a stream's dropped chunks */
+	const char *const *messages; /* printf formats, by kind */
+	size_t max_reported; /* over every report of the list, 0 for no limit */
+} DiagSource;
+
+void diag_push(DiagList *list, Diag diag);
+/* Writes the diagnostics of `list` to `stream` and forgets them (but not
+ * how many were reported or omitted). With `last` set, also notes how many
+ * were over the limit.
+ */
+void diag_report(DiagList *list, FILE *stream, const DiagSource *src, bool last);
+void diag_list_free(DiagList *list);
+
+#endif /* DIAG_H */
@@ -0,0 +1,510 @@
+/* Generates a synthetic, syntactically plausible .atp source for benchmarks
+ * and stress tests: functions made of declarations, assignments, calls and
+ * nested blocks, with comments in between. The output only depends on the
+ * seed and the options (it uses its own PRNG, not rand()), so the same
+ * corpus can be rebuilt on any machine:
+ *   build/gen_atp [-s seed] [-n size] [-o output] [--<mix option>=<n>]...
+ * `size` takes a k/m/g suffix; generation stops after the function that
+ * reaches it. See `mix_options` for what the token mix options do.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "types.h"
+#include "util.h"
+
+/* the relative frequencies of everything generated */
+typedef struct {
+	u32 idents, ints, strings, chars; /* weights of each kind of operand */
+	u32 keyword_pct; /* of identifier operands that are (type) keywords */
+	u32 escape_pct; /* of string/char literal characters that are escapes */
+	u32 line_comment_pct; /* of statements followed by a // comment */
+	u32 block_comment_pct; /* of statements and functions after a block comment */
+	u32 line_len; /* average length of a statement, in bytes */
+	u32 max_depth; /* of nested blocks, i.e. tabs of indentation */
+} Mix;
+
+static Mix mix = {
+	.idents = 50, .ints = 25, .strings = 15, .chars = 10,
+	.keyword_pct = 5,
+	.escape_pct = 10,
+	.line_comment_pct = 15,
+	.block_comment_pct = 10,
+	.line_len = 40,
+	.max_depth = 4,
+};
+
+static const struct {
+	const char *name;
+	u32 *value;
+	const char *help;
+} mix_options[] = {
+	{ "idents", &mix.idents, "weight of identifier operands" },
+	{ "ints", &mix.ints, "weight of integer literal operands (0d, 0x, 0o, 0b or no prefix)" },
+	{ "strings", &mix.strings, "weight of string literal operands" },
+	{ "chars", &mix.chars, "weight of char literal operands" },
+	{ "keywords", &mix.keyword_pct, "% of identifier operands that are keywords" },
+	{ "escapes", &mix.escape_pct, "% of literal characters that are escape sequences" },
+	{ "line-comments", &mix.line_comment_pct, "% of statements followed by a // comment" },
+	{ "block-comments", &mix.block_comment_pct, "% of statements/functions after a /* */ comment" },
+	{ "line-len", &mix.line_len, "average statement length in bytes" },
+	{ "depth", &mix.max_depth, "maximum nesting of blocks (tabs of indentation)" },
+};
+#define N_MIX_OPTIONS (sizeof(mix_options)/sizeof(*mix_options))
+
+/* splitmix64 */
+static u64 rng_state;
+
+static u64 rng_next(void)
+{
+	u64 z = (rng_state += 0x9E3779B97F4A7C15);
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EB;
+	return z ^ (z >> 31);
+}
+
+static u32 rng_below(u32 n)
+{
+	return (n == 0) ? 0 : rng_next() % n;
+}
+
+static bool rng_chance(u32 percent)
+{
+	return rng_below(100) < percent;
+}
+
+#define PICK(arr) ((arr)[rng_below(sizeof(arr)/sizeof(*(arr)))])
+
+static FILE *out;
+static char out_buf[1 << 16];
+static size_t out_len;
+static u64 out_total;
+static size_t col; /* of the line being generated */
+
+static void flush_out(void)
+{
+	if (fwrite(out_buf, 1, out_len, out) != out_len)
+	{
+		flogf(LOG_ERR, stderr, "failed to write output\n");
+		exit(9);
+	}
+	out_len = 0;
+}
+
+static void put(const char *s, size_t len)
+{
+	if (out_len + len > sizeof(out_buf))
+		flush_out();
+	memcpy(out_buf + out_len, s, len);
+	out_len += len;
+	out_total += len;
+	col += len;
+}
+
+static void puts_out(const char *s)
+{
+	put(s, strlen(s));
+}
+
+static void newline(void)
+{
+	put("\n", 1);
+	col = 0;
+}
+
+static void indent(u32 depth)
+{
+	for (u32 i = 0; i < depth; ++i)
+		put("\t", 1);
+}
+
+static const char *type_keywords[] = {
+	"s8", "s16", "s32", "s64", "u8", "u16", "u32", "u64", "char", "string", "slice",
+};
+static const char *name_parts[] = {
+	"buf", "len", "idx", "tmp", "count", "node", "next", "val", "ptr", "size", "str",
+	"key", "map", "item", "res", "err", "pos", "src", "dst", "cur", "line", "tok",
+	"n", "i", "j", "x", "y", "a", "b", "total", "offset", "start", "end", "data",
+};
+static const char *words[] = {
+	"the", "a", "of", "to", "is", "and", "in", "for", "it", "this", "value", "buffer",
+	"pointer", "length", "returns", "if", "not", "we", "can", "be", "used", "here",
+	"TODO:", "maybe", "should", "(see", "above)", "every", "token", "file", "=", "@p1",
+};
+static const char *binary_ops[] = {
+	"+", "-", "*", "/", "%", "<<", ">>", "&", "|", "^", "==", "!=", "<", ">", "<=", ">=",
+};
+static const char *assign_ops[] = {
+	"=", "+=", "-=", "*=", "/=", "%=", "&=", "|=", "^=", "~=",
+};
+static const char *escapes[] = {
+	"\\n", "\\t", "\\r", "\\0", "\\\\", "\\\"", "\\'",
+};
+/* printable characters that can go in a literal unescaped ('"' only in chars,
+ * '\'' only in strings)
+ */
+static const char literal_chars[] =
+	"abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789 !#$%&()*+,-./:;<=>?@[]^_`{|}~";
+
+/* identifiers are drawn from a fixed vocabulary, so names repeat like in
+ * real code
+ */
+#define N_NAMES 512
+static char names[N_NAMES][32];
+
+static void make_names(void)
+{
+	for (size_t i = 0; i < N_NAMES; ++i)
+	{
+		const char *first = PICK(name_parts);
+		switch (rng_below(4)) {
+		case 0:
+			snprintf(names[i], sizeof(names[i]), "%s", first);
+			break;
+		case 1:
+			snprintf(names[i], sizeof(names[i]), "%s_%s", first, PICK(name_parts));
+			break;
+		case 2:
+			snprintf(names[i], sizeof(names[i]), "%s%u", first, rng_below(100));
+			break;
+		default:
+			snprintf(names[i], sizeof(names[i]), "%s_%s_%s", first, PICK(name_parts), PICK(name_parts));
+			break;
+		}
+	}
+}
+
+static void gen_name(void)
+{
+	puts_out(names[rng_below(N_NAMES)]);
+}
+
+static void gen_int(void)
+{
+	static const char dec[] = "0123456789", hex[] = "0123456789abcdefABCDEF";
+	static const char oct[] = "01234567", bin[] = "01";
+	const char *digits;
+	size_t n_digits;
+	switch (rng_below(5)) {
+	case 0:
+		puts_out("0d");
+		digits = dec, n_digits = 1 + rng_below(10);
+		break;
+	case 1:
+		puts_out("0x");
+		digits = hex, n_digits = 1 + rng_below(8);
+		break;
+	case 2:
+		puts_out("0o");
+		digits = oct, n_digits = 1 + rng_below(11);
+		break;
+	case 3:
+		puts_out("0b");
+		digits = bin, n_digits = 1 + rng_below(32);
+		break;
+	default:
+		// no prefix: it can't start with a 0
+		put(&dec[1 + rng_below(9)], 1);
+		digits = dec, n_digits = rng_below(6);
+		break;
+	}
+	size_t n_choices = strlen(digits);
+	for (size_t i = 0; i < n_digits; ++i)
+		put(&digits[rng_below(n_choices)], 1);
+}
+
+static void gen_literal_char(char quote)
+{
+	if (rng_chance(mix.escape_pct))
+	{
+		// the lexer takes no more than two bytes between a char literal's quotes
+		if (quote == '"' && rng_below(8) == 0)
+		{
+			static const char hex[] = "0123456789abcdef";
+			char esc[4] = { '\\', 'x', hex[rng_below(16)], hex[rng_below(16)] };
+			put(esc, 4);
+		} else
+			puts_out(PICK(escapes));
+		return;
+	}
+	char c = literal_chars[rng_below(sizeof(literal_chars) - 1)];
+	// swap in the other quote now and then
+	if (rng_below(32) == 0)
+		c = (quote == '"') ? '\'' : '"';
+	put(&c, 1);
+}
+
+static void gen_string(void)
+{
+	put("\"", 1);
+	u32 len = rng_below(mix.line_len / 2 + 1);
+	for (u32 i = 0; i < len; ++i)
+		gen_literal_char('"');
+	put("\"", 1);
+}
+
+static void gen_char(void)
+{
+	put("'", 1);
+	gen_literal_char('\'');
+	put("'", 1);
+}
+
+static void gen_operand(void)
+{
+	u32 total = mix.idents + mix.ints + mix.strings + mix.chars;
+	u32 r = rng_below(total);
+	if (total == 0 || r < mix.idents)
+	{
+		if (rng_chance(mix.keyword_pct))
+			puts_out(PICK(type_keywords));
+		else
+			gen_name();
+	} else if ((r -= mix.idents) < mix.ints)
+		gen_int();
+	else if ((r -= mix.ints) < mix.strings)
+		gen_string();
+	else
+		gen_char();
+}
+
+static void gen_expr(u32 nesting);
+
+static void gen_call(u32 nesting)
+{
+	gen_name();
+	put("(", 1);
+	u32 n_args = rng_below(4);
+	for (u32 i = 0; i < n_args; ++i)
+	{
+		if (i > 0)
+			puts_out(", ");
+		gen_expr(nesting + 1);
+	}
+	put(")", 1);
+}
+
+/* Operands joined by binary operators until the line is about `line_len`
+ * long (or a few operands, when nested).
+ */
+static void gen_expr(u32 nesting)
+{
+	size_t target = mix.line_len / 2 + rng_below(mix.line_len + 1);
+	u32 n_terms = 0;
+	do {
+		if (n_terms++ > 0)
+		{
+			put(" ", 1);
+			puts_out(PICK(binary_ops));
+			put(" ", 1);
+		}
+		u32 kind = (nesting < 3) ? rng_below(10) : 9;
+		if (kind == 0)
+		{
+			put("(", 1);
+			gen_expr(nesting + 1);
+			put(")", 1);
+		} else if (kind == 1)
+			gen_call(nesting);
+		else
+			gen_operand();
+	} while ((nesting == 0) ? col < target : (n_terms < 2 && rng_below(2) == 0));
+}
+
+static void gen_comment_text(size_t target)
+{
+	do {
+		put(" ", 1);
+		puts_out(PICK(words));
+	} while (col < target);
+}
+
+static void gen_block_comment(u32 depth)
+{
+	indent(depth);
+	puts_out("/*");
+	u32 n_lines = rng_below(4);
+	gen_comment_text(col + mix.line_len);
+	for (u32 i = 0; i < n_lines; ++i)
+	{
+		newline();
+		indent(depth);
+		put(" *", 2);
+		gen_comment_text(col + mix.line_len);
+	}
+	puts_out(" */");
+	newline();
+}
+
+static void gen_block(u32 depth);
+
+static void gen_statement(u32 depth, bool last)
+{
+	if (rng_chance(mix.block_comment_pct))
+		gen_block_comment(depth);
+	indent(depth);
+	size_t start = col;
+	u32 kind = last ? 0 : 1 + rng_below(10);
+	if (kind == 0)
+	{
+		puts_out("return ");
+		gen_expr(0);
+	} else if (kind == 1 && depth < mix.max_depth)
+	{
+		puts_out("{");
+		newline();
+		gen_block(depth + 1);
+		indent(depth);
+		puts_out("}");
+		newline();
+		return;
+	} else if (kind <= 4)
+	{
+		puts_out(PICK(type_keywords));
+		if (rng_below(4) == 0)
+			put("@", 1);
+		put(" ", 1);
+		gen_name();
+		puts_out(" = ");
+		gen_expr(0);
+	} else if (kind <= 5)
+	{
+		gen_name();
+		puts_out(" := ");
+		gen_expr(0);
+	} else if (kind <= 8)
+	{
+		gen_name();
+		put(" ", 1);
+		puts_out(PICK(assign_ops));
+		put(" ", 1);
+		gen_expr(0);
+	} else
+		gen_call(0);
+	put(";", 1);
+	if (rng_chance(mix.line_comment_pct))
+	{
+		puts_out(" //");
+		gen_comment_text(start + mix.line_len * 3 / 2);
+	}
+	newline();
+}
+
+static void gen_block(u32 depth)
+{
+	u32 n_statements = 1 + rng_below(8);
+	for (u32 i = 0; i < n_statements; ++i)
+		gen_statement(depth, false);
+}
+
+static void gen_function(void)
+{
+	if (rng_chance(mix.block_comment_pct))
+		gen_block_comment(0);
+	puts_out("func ");
+	gen_name();
+	put("(", 1);
+	u32 n_params = rng_below(4);
+	for (u32 i = 0; i < n_params; ++i)
+	{
+		if (i > 0)
+			puts_out(", ");
+		puts_out(PICK(type_keywords));
+		put(" ", 1);
+		gen_name();
+		if (rng_below(4) == 0)
+			put("@", 1);
+	}
+	puts_out(") -> ");
+	puts_out(PICK(type_keywords));
+	newline();
+	puts_out("{");
+	newline();
+	gen_block(1);
+	gen_statement(1, true);
+	puts_out("}");
+	newline();
+	newline();
+}
+
+static void usage(void)
+{
+	fprintf(stderr, "Usage: gen_atp [-s seed] [-n size[k|m|g]] [-o output] [--<option>=<n>]...\n");
+	for (size_t i = 0; i < N_MIX_OPTIONS; ++i)
+		fprintf(stderr, "  --%-15s %s (default %u)\n", mix_options[i].name, mix_options[i].help,
+				*mix_options[i].value);
+	exit(1);
+}
+
+static u64 parse_size(const char *arg)
+{
+	char *end;
+	u64 size = strtoull(arg, &end, 10);
+	switch (*end) {
+	case 'k': case 'K': size <<= 10; end++; break;
+	case 'm': case 'M': size <<= 20; end++; break;
+	case 'g': case 'G': size <<= 30; end++; break;
+	default: break;
+	}
+	if (end == arg || *end != '\0')
+		usage();
+	return size;
+}
+
+static void parse_mix_option(const char *arg)
+{
+	const char *eq = strchr(arg, '=');
+	if (eq == NULL)
+		usage();
+	for (size_t i = 0; i < N_MIX_OPTIONS; ++i)
+		if (strlen(mix_options[i].name) == (size_t) (eq - arg)
+		 && strncmp(arg, mix_options[i].name, eq - arg) == 0)
+		{
+			char *end;
+			*mix_options[i].value = strtoul(eq + 1, &end, 10);
+			if (end == eq + 1 || *end != '\0')
+				usage();
+			return;
+		}
+	usage();
+}
+
+s32 main(s32 argc, char **argv)
+{
+	u64 seed = 1, size = 1 << 20;
+	char *out_path = NULL;
+	for (s32 arg_n = 1; arg_n < argc; ++arg_n)
+	{
+		if (strcmp(argv[arg_n], "-s") == 0 && arg_n + 1 < argc)
+			seed = strtoull(argv[++arg_n], NULL, 10);
+		else if (strcmp(argv[arg_n], "-n") == 0 && arg_n + 1 < argc)
+			size = parse_size(argv[++arg_n]);
+		else if (strcmp(argv[arg_n], "-o") == 0 && arg_n + 1 < argc)
+			out_path = argv[++arg_n];
+		else if (strncmp(argv[arg_n], "--", 2) == 0)
+			parse_mix_option(argv[arg_n] + 2);
+		else
+			usage();
+	}
+	if (mix.line_len == 0)
+		mix.line_len = 1;
+
+	out = (out_path != NULL) ? fopen(out_path, "w") : stdout;
+	if (out == NULL)
+	{
+		flogf(LOG_ERR, stderr, "failed to open file '%s'\n", out_path);
+		exit(2);
+	}
+	rng_state = seed;
+	make_names();
+	while (out_total < size)
+		gen_function();
+	flush_out();
+	if (out != stdout && fclose(out) != 0)
+	{
+		flogf(LOG_ERR, stderr, "failed to write output\n");
+		exit(9);
+	}
+	return 0;
+}
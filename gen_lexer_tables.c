@@ -0,0 +1,122 @@
+/* Compiles the token grammar in lexer_spec.h into the lookup tables that
+ * lexer.c dispatches on, and prints them as a C header to stdout.
+ * Run by the Makefile to produce $(OBJ)/lexer_tables.h.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "types.h"
+#include "lexer_spec.h"
+
+#define MAX_STATES 256
+
+typedef struct {
+	const char *lexeme;
+	const char *type;
+	const char *subtype;
+} OperatorSpec;
+
+static const OperatorSpec operators[] = {
+#define OPERATOR(lexeme, type, subtype) { lexeme, #type, #subtype },
+	LEXER_OPERATORS(OPERATOR)
+#undef OPERATOR
+};
+#define N_OPERATORS (sizeof(operators)/sizeof(*operators))
+
+static u8 char_class[256];
+static u8 op_column[256]; /* 0 if the byte never occurs in an operator */
+static size_t n_columns = 1;
+static u8 transitions[MAX_STATES][256];
+static s32 accepts[MAX_STATES]; /* index into `operators`, or -1 */
+static size_t n_states = 1;
+
+static void fail(const char *msg, const char *lexeme)
+{
+	fprintf(stderr, "gen_lexer_tables: %s: \"%s\"\n", msg, lexeme);
+	exit(1);
+}
+
+s32 main(void)
+{
+#define CHAR_CLASS(class, first, last) \
+	for (s32 c = (first); c <= (last); ++c) \
+		char_class[c] = (class);
+	LEXER_CHAR_CLASSES(CHAR_CLASS)
+#undef CHAR_CLASS
+
+	for (size_t s = 0; s < MAX_STATES; ++s)
+		accepts[s] = -1;
+
+	// build a trie of all lexemes; its nodes are the DFA's states
+	for (size_t i = 0; i < N_OPERATORS; ++i)
+	{
+		const char *lexeme = operators[i].lexeme;
+		if (*lexeme == '\0')
+			fail("empty lexeme", lexeme);
+		if (char_class[(u8) *lexeme] != CC_OTHER && char_class[(u8) *lexeme] != CC_OPERATOR)
+			fail("lexeme starts with a byte of another character class", lexeme);
+		char_class[(u8) *lexeme] = CC_OPERATOR;
+
+		size_t state = 0;
+		for (const char *c = lexeme; *c; ++c)
+		{
+			if (op_column[(u8) *c] == 0)
+				op_column[(u8) *c] = n_columns++;
+			u8 *next = &transitions[state][op_column[(u8) *c]];
+			if (*next == 0)
+			{
+				if (n_states == MAX_STATES)
+					fail("too many states", lexeme);
+				*next = n_states++;
+			}
+			state = *next;
+		}
+		if (accepts[state] != -1)
+			fail("duplicate lexeme", lexeme);
+		accepts[state] = i;
+	}
+
+	printf("/* generated by gen_lexer_tables from lexer_spec.h; do not edit */\n"
+	       "#ifndef LEXER_TABLES_H\n"
+	       "#define LEXER_TABLES_H\n\n");
+
+	printf("static const u8 lex_char_class[256] = {");
+	for (size_t c = 0; c < 256; ++c)
+		printf("%s%u,", (c % 16 == 0) ? "\n\t" : " ", char_class[c]);
+	printf("\n};\n\n");
+
+	printf("#define LEX_OP_COLUMNS %zu\n", n_columns);
+	printf("static const u8 lex_op_column[256] = {");
+	for (size_t c = 0; c < 256; ++c)
+		printf("%s%u,", (c % 16 == 0) ? "\n\t" : " ", op_column[c]);
+	printf("\n};\n\n");
+
+	printf("/* next state by [state][column]; 0 means no transition */\n");
+	printf("static const u8 lex_op_next[%zu][LEX_OP_COLUMNS] = {\n", n_states);
+	for (size_t s = 0; s < n_states; ++s)
+	{
+		printf("\t{");
+		for (size_t col = 0; col < n_columns; ++col)
+			printf("%s%u", (col == 0) ? "" : ", ", transitions[s][col]);
+		printf("},\n");
+	}
+	printf("};\n\n");
+
+	printf("/* the token recognized on reaching each state; len 0 means not accepting */\n");
+	printf("static const struct { u8 len; TokenType type; TokenSubType subtype; } lex_op_accept[%zu] = {\n",
+			n_states);
+	for (size_t s = 0; s < n_states; ++s)
+	{
+		if (accepts[s] == -1)
+			printf("\t{ 0, MiscToken, ERROR_TOKEN },\n");
+		else
+			printf("\t{ %zu, %s, %s }, /* %s */\n", strlen(operators[accepts[s]].lexeme),
+					operators[accepts[s]].type, operators[accepts[s]].subtype,
+					operators[accepts[s]].lexeme);
+	}
+	printf("};\n\n");
+
+	printf("#endif /* LEXER_TABLES_H */\n");
+	return 0;
+}
@@ -0,0 +1,130 @@
+#include "job_pool.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "types.h"
+#include "util.h"
+
+typedef struct {
+	JobPool *pool;
+	u32 id;
+} Worker;
+
+static void *pool_alloc(size_t size)
+{
+	void *ret = calloc(1, size);
+	if (ret == NULL)
+	{
+		flogf(LOG_ERR, stderr, "failed to allocate job pool\n");
+		exit(3);
+	}
+	return ret;
+}
+
+/* Takes the next job from `queue`, from its front if `own` and otherwise
+ * from its back. Returns false if it's empty.
+ */
+static bool queue_take(JobQueue *queue, bool own, size_t *job)
+{
+	pthread_mutex_lock(&queue->lock);
+	bool ret = (queue->head < queue->tail);
+	if (ret)
+		*job = own ? queue->jobs[queue->head++] : queue->jobs[--queue->tail];
+	pthread_mutex_unlock(&queue->lock);
+	return ret;
+}
+
+static void *worker_main(void *arg)
+{
+	Worker *worker = arg;
+	JobPool *pool = worker->pool;
+	size_t job;
+	for (;;)
+	{
+		bool found = queue_take(&pool->queues[worker->id], true, &job);
+		// no job is ever added, so once every queue is empty the worker is done
+		for (u32 i = 1; !found && i < pool->n_threads; ++i)
+			found = queue_take(&pool->queues[(worker->id + i) % pool->n_threads], false, &job);
+		if (!found)
+			break;
+
+		pool->run(job, worker->id, pool->ctx);
+
+		pthread_mutex_lock(&pool->done_lock);
+		pool->done[job] = true;
+		pthread_cond_broadcast(&pool->done_cond);
+		pthread_mutex_unlock(&pool->done_lock);
+	}
+	free(worker);
+	return NULL;
+}
+
+void job_pool_start(JobPool *pool, size_t n_jobs, const size_t *order, u32 n_threads,
+		JobFunc run, void *ctx)
+{
+	*pool = (JobPool) {0};
+	pool->run = run;
+	pool->ctx = ctx;
+	pool->n_threads = MAX(MIN(n_threads, n_jobs), 1);
+	pool->threads = pool_alloc(pool->n_threads * sizeof(pthread_t));
+	pool->queues = pool_alloc(pool->n_threads * sizeof(JobQueue));
+	pool->done = pool_alloc(MAX(n_jobs, 1) * sizeof(bool));
+	pthread_mutex_init(&pool->done_lock, NULL);
+	pthread_cond_init(&pool->done_cond, NULL);
+
+	for (u32 t = 0; t < pool->n_threads; ++t)
+	{
+		JobQueue *queue = &pool->queues[t];
+		pthread_mutex_init(&queue->lock, NULL);
+		queue->jobs = pool_alloc((n_jobs / pool->n_threads + 1) * sizeof(size_t));
+	}
+	for (size_t i = 0; i < n_jobs; ++i)
+	{
+		JobQueue *queue = &pool->queues[i % pool->n_threads];
+		queue->jobs[queue->tail++] = order[i];
+	}
+
+	for (u32 t = 0; t < pool->n_threads; ++t)
+	{
+		Worker *worker = pool_alloc(sizeof(Worker));
+		*worker = (Worker) { pool, t };
+		if (pthread_create(&pool->threads[t], NULL, worker_main, worker) != 0)
+		{
+			flogf(LOG_ERR, stderr, "failed to start worker thread %u\n", t);
+			exit(3);
+		}
+	}
+}
+
+void job_pool_wait(JobPool *pool, size_t job)
+{
+	pthread_mutex_lock(&pool->done_lock);
+	while (!pool->done[job])
+		pthread_cond_wait(&pool->done_cond, &pool->done_lock);
+	pthread_mutex_unlock(&pool->done_lock);
+}
+
+void job_pool_finish(JobPool *pool)
+{
+	for (u32 t = 0; t < pool->n_threads; ++t)
+		pthread_join(pool->threads[t], NULL);
+	for (u32 t = 0; t < pool->n_threads; ++t)
+	{
+		pthread_mutex_destroy(&pool->queues[t].lock);
+		free(pool->queues[t].jobs);
+	}
+	pthread_mutex_destroy(&pool->done_lock);
+	pthread_cond_destroy(&pool->done_cond);
+	free(pool->threads);
+	free(pool->queues);
+	free(pool->done);
+	*pool = (JobPool) {0};
+}
+
+u32 job_pool_default_threads(void)
+{
+	long n = sysconf(_SC_NPROCESSORS_ONLN);
+	return (n > 0) ? (u32) n : 1;
+}
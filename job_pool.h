@@ -0,0 +1,49 @@
+#ifndef JOB_POOL_H
+#define JOB_POOL_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "types.h"
+
+/* A fixed set of independent jobs run on a pool of worker threads. Jobs are
+ * dealt out round-robin in the order given, so each worker starts on its
+ * share of the front of that order; a worker that runs out takes jobs from
+ * the back of another worker's queue.
+ */
+
+/* `worker` is the index (< n_threads) of the thread running the job, e.g.
+ * for per-thread scratch space.
+ */
+typedef void (*JobFunc)(size_t job, u32 worker, void *ctx);
+
+typedef struct {
+	pthread_mutex_t lock;
+	size_t *jobs;
+	size_t head, tail; /* the owner takes from the head, thieves from the tail */
+} JobQueue;
+
+typedef struct JobPool {
+	JobFunc run;
+	void *ctx;
+	u32 n_threads;
+	pthread_t *threads;
+	JobQueue *queues;
+	pthread_mutex_t done_lock;
+	pthread_cond_t done_cond;
+	bool *done; /* by job */
+} JobPool;
+
+/* Starts running `n_jobs` jobs, `order[0]` first, on `n_threads` threads. */
+void job_pool_start(JobPool *pool, size_t n_jobs, const size_t *order, u32 n_threads,
+		JobFunc run, void *ctx);
+/* Blocks until `job` has finished. */
+void job_pool_wait(JobPool *pool, size_t job);
+/* Waits for every job and frees the pool. */
+void job_pool_finish(JobPool *pool);
+
+/* number of online CPUs, at least 1 */
+u32 job_pool_default_threads(void);
+
+#endif /* JOB_POOL_H */
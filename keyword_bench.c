@@ -0,0 +1,122 @@
+/* Microbenchmark of identifier classification: `keyword_type()` from lexer.c
+ * against the c-hashmap lookup the lexer used to do for every identifier.
+ * Needs the c-hashmap submodule (see README.md); build/run with
+ * `make build/keyword_bench && build/keyword_bench [n_idents] [n_rounds]`.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "types.h"
+#include "util.h"
+#include "lexer.h"
+#include "c-hashmap/map.h"
+
+static const char *keywords[] = {
+	"func", "return", "obtain", "s8", "s16", "s32", "s64",
+	"u8", "u16", "u32", "u64", "char", "string", "slice",
+};
+#define N_KEYWORDS (sizeof(keywords)/sizeof(*keywords))
+
+static hashmap *old_keyword_map_init(void)
+{
+	hashmap *map = hashmap_create();
+	hashmap_set(map, hashmap_str_lit("func"), FUNC_KEYWORD);
+	hashmap_set(map, hashmap_str_lit("return"), RETURN_KEYWORD);
+	hashmap_set(map, hashmap_str_lit("obtain"), RESERVED_KEYWORD);
+	hashmap_set(map, hashmap_str_lit("s8"), TYPE_KEYWORD);
+	hashmap_set(map, hashmap_str_lit("s16"), TYPE_KEYWORD);
+	hashmap_set(map, hashmap_str_lit("s32"), TYPE_KEYWORD);
+	hashmap_set(map, hashmap_str_lit("s64"), TYPE_KEYWORD);
+	hashmap_set(map, hashmap_str_lit("u8"), TYPE_KEYWORD);
+	hashmap_set(map, hashmap_str_lit("u16"), TYPE_KEYWORD);
+	hashmap_set(map, hashmap_str_lit("u32"), TYPE_KEYWORD);
+	hashmap_set(map, hashmap_str_lit("u64"), TYPE_KEYWORD);
+	hashmap_set(map, hashmap_str_lit("char"), TYPE_KEYWORD);
+	hashmap_set(map, hashmap_str_lit("string"), TYPE_KEYWORD);
+	hashmap_set(map, hashmap_str_lit("slice"), TYPE_KEYWORD);
+	return map;
+}
+
+static TokenSubType old_keyword_type(hashmap *map, struct str_buf ident)
+{
+	uintptr_t ret = 0;
+	if (hashmap_get(map, ident.buf, ident.len, &ret) == 0)
+		return NORMAL_IDENTIFIER;
+	return (TokenSubType) ret;
+}
+
+static double now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+s32 main(s32 argc, char **argv)
+{
+	size_t n_idents = (argc > 1) ? strtoul(argv[1], NULL, 10) : 100000;
+	size_t n_rounds = (argc > 2) ? strtoul(argv[2], NULL, 10) : 100;
+
+	// roughly one identifier in ten is a keyword, the rest are random names
+	static const char ident_chars[] = "abcdefghijklmnopqrstuvwxyz_0123456789";
+	struct str_buf *idents = malloc(n_idents * sizeof(struct str_buf));
+	char *pool = malloc(n_idents * 16);
+	if (idents == NULL || pool == NULL)
+	{
+		flogf(LOG_ERR, stderr, "failed to allocate %zu identifiers\n", n_idents);
+		exit(3);
+	}
+	srand(1);
+	for (size_t i = 0; i < n_idents; ++i)
+	{
+		char *buf = pool + i*16;
+		size_t len;
+		if (rand() % 10 == 0)
+		{
+			const char *kw = keywords[rand() % N_KEYWORDS];
+			len = strlen(kw);
+			memcpy(buf, kw, len);
+		} else
+		{
+			len = 1 + rand() % 12;
+			buf[0] = ident_chars[rand() % 26];
+			for (size_t j = 1; j < len; ++j)
+				buf[j] = ident_chars[rand() % (sizeof(ident_chars) - 1)];
+		}
+		idents[i] = strbuflit(buf, len, NULL);
+	}
+
+	hashmap *map = old_keyword_map_init();
+	for (size_t i = 0; i < n_idents; ++i)
+		if (keyword_type(idents[i]) != old_keyword_type(map, idents[i]))
+		{
+			flogf(LOG_ERR, stderr, "classification mismatch for '%.*s'\n",
+					(int) idents[i].len, idents[i].buf);
+			return 1;
+		}
+
+	u64 checksum = 0;
+	double start = now_ns();
+	for (size_t r = 0; r < n_rounds; ++r)
+		for (size_t i = 0; i < n_idents; ++i)
+			checksum += keyword_type(idents[i]);
+	double switch_ns = now_ns() - start;
+
+	start = now_ns();
+	for (size_t r = 0; r < n_rounds; ++r)
+		for (size_t i = 0; i < n_idents; ++i)
+			checksum += old_keyword_type(map, idents[i]);
+	double hashmap_ns = now_ns() - start;
+
+	double n_lookups = (double) n_idents * n_rounds;
+	printf("keyword_type:  %6.2f ns/ident\n", switch_ns / n_lookups);
+	printf("hashmap_get:   %6.2f ns/ident\n", hashmap_ns / n_lookups);
+	printf("speedup:       %6.2fx (checksum %" PRIu64 ")\n", hashmap_ns / switch_ns, checksum);
+
+	hashmap_free(map);
+	free(pool);
+	free(idents);
+	return 0;
+}
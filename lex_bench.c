@@ -0,0 +1,181 @@
+/* Throughput benchmark of the stages a source file goes through: reading it
+ * (`read_file_to_string`), stripping its comments (`strip_comments`) and
+ * lexing it with `next_token` (output disabled). Every stage is timed over
+ * several runs per input file and reported as MB/s, tokens/s and ns/token
+ * from the median run, plus the fastest run.
+ *
+ * `make bench` builds it and runs it on BENCH_FILES; results are also
+ * written as tab-separated values to `-o` (bench_output.txt by default) so
+ * two builds can be compared:
+ *   build/lex_bench [-r runs] [-o output] <file>...
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "arena.h"
+#include "lexer.h"
+#include "preproc.h"
+#include "types.h"
+#include "util.h"
+
+extern char *SRC_PATH_L;
+
+#define DEFAULT_RUNS 21
+/* a run repeats its stage until it took at least this long, so tiny inputs
+ * aren't measured below the clock's resolution
+ */
+#define MIN_RUN_NS 2000000
+
+typedef enum {
+	STAGE_READ,
+	STAGE_STRIP,
+	STAGE_LEX,
+	N_STAGES,
+} Stage;
+
+static const char *stage_names[N_STAGES] = { "read_file_to_string", "strip_comments", "next_token" };
+
+typedef struct {
+	char *path;
+	struct str_buf contents; /* from read_file_to_string, for strip_comments */
+	SourceFile src; /* what the lexer runs on */
+	Arena arena;
+	size_t n_tokens; /* counted by the last lex */
+} BenchInput;
+
+static u64 now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (u64) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void run_stage(Stage stage, BenchInput *in)
+{
+	switch (stage) {
+	case STAGE_READ:
+		free(read_file_to_string(in->path).buf);
+		break;
+	case STAGE_STRIP:
+		arena_reset(&in->arena);
+		strip_comments(in->contents, in->path, &in->arena);
+		break;
+	case STAGE_LEX:
+		in->n_tokens = 0;
+		lexer_init(in->src.contents);
+		while (!is_null_token(next_token()))
+			in->n_tokens++;
+		break;
+	default:
+		break;
+	}
+}
+
+static int cmp_u64(const void *a, const void *b)
+{
+	u64 x = *(const u64 *) a, y = *(const u64 *) b;
+	return (x > y) - (x < y);
+}
+
+/* Times `runs` runs of `stage` on `in` into `ns` (per repetition), sorted. */
+static void time_stage(Stage stage, BenchInput *in, u64 *ns, size_t runs)
+{
+	// warm up, and find out how many repetitions make up one run
+	size_t reps = 1;
+	for (;;)
+	{
+		u64 start = now_ns();
+		for (size_t i = 0; i < reps; ++i)
+			run_stage(stage, in);
+		if (now_ns() - start >= MIN_RUN_NS)
+			break;
+		reps *= 2;
+	}
+
+	for (size_t r = 0; r < runs; ++r)
+	{
+		u64 start = now_ns();
+		for (size_t i = 0; i < reps; ++i)
+			run_stage(stage, in);
+		ns[r] = (now_ns() - start) / reps;
+	}
+	qsort(ns, runs, sizeof(u64), cmp_u64);
+}
+
+static void usage(void)
+{
+	fprintf(stderr, "Usage: lex_bench [-r runs] [-o output] <file>...\n");
+	exit(1);
+}
+
+s32 main(s32 argc, char **argv)
+{
+	size_t runs = DEFAULT_RUNS;
+	char *out_path = "bench_output.txt";
+	s32 arg_n = 1;
+	for (; arg_n < argc && argv[arg_n][0] == '-'; ++arg_n)
+	{
+		if (strcmp(argv[arg_n], "-r") == 0 && arg_n + 1 < argc)
+			runs = strtoul(argv[++arg_n], NULL, 10);
+		else if (strcmp(argv[arg_n], "-o") == 0 && arg_n + 1 < argc)
+			out_path = argv[++arg_n];
+		else
+			usage();
+	}
+	if (arg_n == argc || runs == 0)
+		usage();
+
+	FILE *out = fopen(out_path, "w");
+	u64 *ns = malloc(runs * sizeof(u64));
+	if (out == NULL)
+	{
+		flogf(LOG_ERR, stderr, "failed to open file '%s'\n", out_path);
+		exit(2);
+	}
+	if (ns == NULL)
+	{
+		flogf(LOG_ERR, stderr, "failed to allocate %zu timings\n", runs);
+		exit(3);
+	}
+	fprintf(out, "file\tstage\tbytes\ttokens\truns\tmin_ns\tmedian_ns\tmb_per_s\ttokens_per_s\tns_per_token\n");
+
+	// comments are skipped by the lexer, as in build/lexer, and nothing
+	// is printed while lexing
+	lexer_options = LEXER_SKIP_COMMENTS | LEXER_QUIET;
+	for (; arg_n < argc; ++arg_n)
+	{
+		BenchInput in = { .path = argv[arg_n] };
+		SRC_PATH_L = in.path;
+		in.contents = read_file_to_string(in.path);
+		in.src = load_source_file(in.path);
+		run_stage(STAGE_LEX, &in);
+		// the terminating NUL isn't part of the input
+		size_t n_bytes = in.src.contents.len - 1;
+
+		printf("%s: %zu bytes, %zu tokens\n", in.path, n_bytes, in.n_tokens);
+		for (Stage stage = 0; stage < N_STAGES; ++stage)
+		{
+			time_stage(stage, &in, ns, runs);
+			double median = (runs % 2 == 1) ? ns[runs/2] : (ns[runs/2 - 1] + ns[runs/2]) / 2.0;
+			double mb_per_s = n_bytes / 1e6 / (median / 1e9);
+			double tokens_per_s = in.n_tokens / (median / 1e9);
+			double ns_per_token = (in.n_tokens > 0) ? median / in.n_tokens : 0;
+			printf("  %-20s %10.2f MB/s %14.0f tokens/s %8.2f ns/token (min %" PRIu64 " ns, median %.0f ns)\n",
+					stage_names[stage], mb_per_s, tokens_per_s, ns_per_token, ns[0], median);
+			fprintf(out, "%s\t%s\t%zu\t%zu\t%zu\t%" PRIu64 "\t%.0f\t%.3f\t%.0f\t%.3f\n",
+					in.path, stage_names[stage], n_bytes, in.n_tokens, runs, ns[0], median,
+					mb_per_s, tokens_per_s, ns_per_token);
+		}
+
+		arena_free(&in.arena);
+		unload_source_file(&in.src);
+		free(in.contents.buf);
+	}
+	freetmp();
+	free(ns);
+	fclose(out);
+	printf("results written to %s\n", out_path);
+	return 0;
+}
@@ -0,0 +1,204 @@
+#include "lex_parallel.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "job_pool.h"
+#include "lexer.h"
+#include "literal.h"
+#include "token_table.h"
+#include "types.h"
+#include "util.h"
+
+#define N_HYPOTHESES 2 /* outside of any literal, inside a string */
+
+/* Inside a string, every byte is its own token, so a wrong guess that a
+ * chunk starts in one (which turns the code after it inside out) costs far
+ * more than lexing it. The guess is given up once more than this many bytes,
+ * and more than half of the chunk so far, were in strings; should it have
+ * been right after all, the chunk is lexed again once the one before it is
+ * done.
+ */
+#define LEX_PARALLEL_MAX_GUESSED_STRING (64 * 1024)
+
+typedef struct {
+	bool valid; /* false if it wasn't run or was given up */
+	TokenTable tokens;
+	char *first; /* where the first token was looked for, after skipping whitespace and comments */
+	Lexer end; /* state after the last token, at the start of the next chunk's tokens */
+} ChunkRun;
+
+typedef struct {
+	struct str_buf source;
+	char *filename;
+	char **bounds; /* n_chunks + 1, each at the start of a line */
+	size_t n_chunks;
+	ChunkRun *runs; /* by chunk * N_HYPOTHESES + hypothesis */
+} ParallelLex;
+
+/* Lexes the chunk ending at `chunk_end` with `lx`, which is positioned at
+ * its start, into `run`. `guessed_string` is set if `lx` was put inside a
+ * string on a guess.
+ */
+static void lex_chunk(ParallelLex *pl, Lexer *lx, char *chunk_end, ChunkRun *run, bool guessed_string)
+{
+	char *chunk_start = lx->token_start_pos;
+	lx->options |= LEXER_QUIET;
+	lx->need_input = false;
+	lx->more_input = (chunk_end != pl->source.buf + pl->source.len);
+	lx->refill_at = chunk_end;
+	lx->sidx.window_start = lx->sidx.window_end = NULL;
+	token_table_init(&run->tokens, pl->source, pl->filename);
+
+	Token token;
+	size_t string_bytes = 0;
+	run->first = NULL;
+	run->valid = true;
+	while (!lx->stream_will_terminate && !is_null_token(token = lexer_next(lx)))
+	{
+		if (guessed_string && lx->n_dquotes % 2 == 1 && (string_bytes += token.value.len)
+				> MAX(LEX_PARALLEL_MAX_GUESSED_STRING, (size_t) (lx->token_pos - chunk_start) / 2))
+		{
+			run->valid = false;
+			break;
+		}
+		if (run->first == NULL)
+			run->first = lx->token_pos;
+		token_table_push(&run->tokens, token);
+	}
+	if (run->first == NULL)
+		run->first = lx->token_pos;
+
+	// only the state is needed from here on
+	lexer_cleanup(lx);
+	run->end = *lx;
+}
+
+static void lex_chunk_job(size_t job, u32 worker, void *ctx)
+{
+	(void) worker;
+	ParallelLex *pl = ctx;
+	size_t chunk = job / N_HYPOTHESES;
+	bool in_string = (job % N_HYPOTHESES == 1);
+	// the first chunk starts outside of a literal, and coalesced literals
+	// never leave the lexer inside one between tokens
+	if (in_string && (chunk == 0 || (lexer_options & LEXER_COALESCE_LITERALS)))
+		return;
+
+	Lexer lx;
+	lexer_setup(&lx, pl->source, pl->filename);
+	lx.token_start_pos = pl->bounds[chunk];
+	lx.token_pos = lx.token_start_pos;
+	lx.n_dquotes = in_string;
+	lex_chunk(pl, &lx, pl->bounds[chunk+1], &pl->runs[job], in_string);
+}
+
+/* Splits the source into at most `n` chunks starting at line starts. */
+static void split_chunks(ParallelLex *pl, size_t n)
+{
+	char *start = pl->source.buf, *end = pl->source.buf + pl->source.len;
+	pl->bounds = malloc((n + 1) * sizeof(char *));
+	if (pl->bounds == NULL)
+	{
+		flogf(LOG_ERR, stderr, "failed to allocate chunk list\n");
+		exit(3);
+	}
+	pl->bounds[0] = start;
+	pl->n_chunks = 0;
+	for (size_t i = 1; i < n; ++i)
+	{
+		char *target = start + pl->source.len / n * i;
+		if (target <= pl->bounds[pl->n_chunks])
+			continue;
+		char *newline = memchr(target, '\n', end - target);
+		if (newline == NULL)
+			break;
+		pl->bounds[++pl->n_chunks] = newline + 1;
+	}
+	pl->bounds[++pl->n_chunks] = end;
+}
+
+/* Whether `prev` stopped where and how speculative run `h` of the next chunk
+ * started, so that the run's tokens are the ones serial lexing would produce.
+ */
+static bool run_continues(const Lexer *prev, size_t h, const ChunkRun *run)
+{
+	if (!run->valid || !prev->need_input)
+		return false;
+	// state a run doesn't speculate on
+	if (prev->n_squotes % 2 != 0 || prev->in_char_for != 0 || prev->is_escaped_char)
+		return false;
+	return prev->n_dquotes % 2 == h && prev->token_pos == run->first;
+}
+
+static void append_table(TokenTable *dst, const TokenTable *src)
+{
+	for (size_t i = 0; i < src->len; ++i)
+		token_table_push(dst, token_table_get(src, i));
+}
+
+bool lex_parallel(struct str_buf source, char *filename, u32 n_threads, TokenTable *table,
+		LexParallelInfo *info)
+{
+	ParallelLex pl = { .source = source, .filename = filename };
+	split_chunks(&pl, MAX(n_threads, 1));
+	size_t n_runs = pl.n_chunks * N_HYPOTHESES;
+	pl.runs = calloc(n_runs, sizeof(ChunkRun));
+	size_t *order = malloc(n_runs * sizeof(size_t));
+	if (pl.runs == NULL || order == NULL)
+	{
+		flogf(LOG_ERR, stderr, "failed to allocate chunk runs\n");
+		exit(3);
+	}
+
+	for (size_t job = 0; job < n_runs; ++job)
+		order[job] = job;
+	JobPool pool;
+	job_pool_start(&pool, n_runs, order, n_threads, lex_chunk_job, &pl);
+	job_pool_finish(&pool);
+
+	// reconcile left to right
+	Lexer prev_end = pl.runs[0].end;
+	append_table(table, &pl.runs[0].tokens);
+	bool ok = (prev_end.errflags == 0);
+	size_t n_speculated = 0;
+	for (size_t chunk = 1; ok && chunk < pl.n_chunks; ++chunk)
+	{
+		ChunkRun *chosen = NULL;
+		for (size_t h = 0; h < N_HYPOTHESES && chosen == NULL; ++h)
+		{
+			ChunkRun *run = &pl.runs[chunk * N_HYPOTHESES + h];
+			if (run_continues(&prev_end, h, run))
+				chosen = run;
+		}
+		if (chosen != NULL)
+		{
+			append_table(table, &chosen->tokens);
+			prev_end = chosen->end;
+			n_speculated++;
+		} else
+		{
+			// no speculation matched (e.g. a comment or char literal spans the
+			// split), so carry on from where the previous chunk stopped
+			ChunkRun rerun;
+			Lexer lx = prev_end;
+			lx.literals = (LiteralPool) {0};
+			lex_chunk(&pl, &lx, pl.bounds[chunk+1], &rerun, false);
+			append_table(table, &rerun.tokens);
+			token_table_free(&rerun.tokens);
+			prev_end = rerun.end;
+		}
+		ok = (prev_end.errflags == 0);
+	}
+
+	for (size_t i = 0; i < n_runs; ++i)
+		token_table_free(&pl.runs[i].tokens);
+	free(order);
+	free(pl.runs);
+	free(pl.bounds);
+	if (info != NULL)
+		*info = (LexParallelInfo) { pl.n_chunks, n_speculated };
+	if (!ok)
+		table->len = 0;
+	return ok;
+}
@@ -0,0 +1,39 @@
+#ifndef LEX_PARALLEL_H
+#define LEX_PARALLEL_H
+
+#include <stdbool.h>
+
+#include "lexer.h"
+#include "token_table.h"
+#include "types.h"
+#include "util.h"
+
+/* Lexes one large source on several threads. The source is split into
+ * chunks at newlines, and every chunk is lexed speculatively, once as if it
+ * started outside of any literal and once as if it started inside a string
+ * (only the former with LEXER_COALESCE_LITERALS, which never stops inside
+ * one, and the latter only as long as that string stays short). Going left to right, a chunk's speculative tokens are kept if the
+ * chunk before it really ended in that state at the same position;
+ * otherwise (e.g. a char literal or a comment spanning the split) that chunk
+ * is lexed again, continuing from where the one before it stopped. The
+ * result is the same token stream as lexing the source serially.
+ */
+
+/* sources smaller than this aren't worth splitting */
+#define LEX_PARALLEL_MIN_SIZE (1 << 20)
+
+/* how much of the speculative lexing was kept */
+typedef struct {
+	size_t n_chunks;
+	size_t n_speculated; /* chunks after the first whose speculative tokens were kept */
+} LexParallelInfo;
+
+/* Lexes `source` into `table` (initialized over the same source) with up to
+ * `n_threads` chunks, and fills in `info` unless it is NULL. Returns false,
+ * with `table` emptied, if lexing raised an error: no diagnostics are
+ * printed, so the source should be lexed serially to report it.
+ */
+bool lex_parallel(struct str_buf source, char *filename, u32 n_threads, TokenTable *table,
+		LexParallelInfo *info);
+
+#endif /* LEX_PARALLEL_H */
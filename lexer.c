@@ -1,5 +1,6 @@
 #include "lexer.h"
 
+#include <stdarg.h>
 #include <stdbool.h>
 #include <ctype.h>
 #include <string.h>
@@ -7,71 +8,325 @@
 #include "types.h"
 #include "util.h"
 #include "args.h"
-#include "c-hashmap/map.h"
+#include "trace.h"
+#include "diag.h"
+#include "lexer_spec.h"
+#include "scan.h"
+#include "structural.h"
+#include "literal.h"
+#include "preproc.h"
+#include "token_cache.h"
+#include "lexer_tables.h" // generated from lexer_spec.h
 
 char *SRC_PATH_L = NULL;
+char **SRC_PATHS_L = NULL;
+size_t N_SRC_PATHS_L = 0;
+u32 lexer_options = 0;
+u32 lexer_jobs = 0;
+char *lexer_cache_dir = NULL;
+u64 lexer_cache_size = TOKEN_CACHE_DEFAULT_SIZE;
+size_t lexer_max_diagnostics = LEXER_DEFAULT_MAX_DIAGNOSTICS;
 
 void print_usage_msg_lexer(void)
 {
-	error(1, "usage: %s [options] <in_file>\n\n"
+	error(1, "usage: %s [options] <in_file>...\n\n"
 
 		   "  -d, --debug      enable debug output\n"
+		   "  --stats          print timings per phase and counts per token class\n"
+		   "                   to stderr at the end\n"
+		   "  --coalesce-literals\n"
+		   "                   emit each string/char literal as a single token\n"
+		   "  --stream         read the input in chunks instead of all at once\n"
+		   "                   (always done if <in_file> is '-', i.e. stdin)\n"
+		   "  -j, --jobs=N     lex multiple files, or parts of one large file, on N\n"
+		   "                   threads (default: one per CPU)\n"
+		   "  --format=FMT     print tokens as 'text' (the default) or 'bin', a binary\n"
+		   "                   file that can be mapped and indexed (see token_file.h)\n"
+		   "  --embed-source   include each file's source in --format=bin output\n"
+		   "  --verify-parallel\n"
+		   "                   lex the file both serially and in parallel and compare\n"
+		   "  --files-from=FILE\n"
+		   "                   also lex the files listed in FILE, one per line\n"
+		   "  --cache-dir=DIR  reuse the output for files lexed before, kept in DIR\n"
+		   "                   (see token_cache.h)\n"
+		   "  --cache-size=N[k|m|g]\n"
+		   "                   evict the least recently used entries from DIR down to\n"
+		   "                   N bytes (default: 256m)\n"
+		   "  --cache-stats    print the cache's hit rate and traffic to stderr\n"
+		   "  --max-diagnostics=N\n"
+		   "                   report at most N diagnostics per file, 0 for all\n"
+		   "                   (default: 100)\n"
 			, PROG_NAME);
 }
 
-static struct str_buf source_code = {0};
-static bool stream_will_terminate = false,
-		lexer_is_initialized = false;
-static char *token_start_pos = NULL;
-static bool is_escaped_char = false;
-static u8 n_consec_backslashes = 0;
-static size_t n_dquotes = 0,
-		  n_squotes = 0;
-static char *str_start = NULL,
-		*chr_start = NULL;
-static size_t str_start_line = 0,
-		  chr_start_line = 0;
-static size_t line_n = 1;
-static size_t token_n = 0;
-#define IN_STRING() (n_dquotes % 2 == 1)
-#define IN_CHAR() (n_squotes %2 == 1)
-static size_t in_char_for = 0;
-#define IS_ESCAPED() (n_consec_backslashes % 2 == 1)
-
-hashmap *keyword_map;
-
-void keyword_map_init(void)
+static void add_src_path(char *path)
 {
-	keyword_map = hashmap_create();
-
-	hashmap_set(keyword_map, hashmap_str_lit("func"), FUNC_KEYWORD);
-	hashmap_set(keyword_map, hashmap_str_lit("return"), RETURN_KEYWORD);
-	hashmap_set(keyword_map, hashmap_str_lit("obtain"), RESERVED_KEYWORD);
-	hashmap_set(keyword_map, hashmap_str_lit("s8"), TYPE_KEYWORD);
-	hashmap_set(keyword_map, hashmap_str_lit("s16"), TYPE_KEYWORD);
-	hashmap_set(keyword_map, hashmap_str_lit("s32"), TYPE_KEYWORD);
-	hashmap_set(keyword_map, hashmap_str_lit("s64"), TYPE_KEYWORD);
-	hashmap_set(keyword_map, hashmap_str_lit("u8"), TYPE_KEYWORD);
-	hashmap_set(keyword_map, hashmap_str_lit("u16"), TYPE_KEYWORD);
-	hashmap_set(keyword_map, hashmap_str_lit("u32"), TYPE_KEYWORD);
-	hashmap_set(keyword_map, hashmap_str_lit("u64"), TYPE_KEYWORD);
-	hashmap_set(keyword_map, hashmap_str_lit("char"), TYPE_KEYWORD);
-	hashmap_set(keyword_map, hashmap_str_lit("string"), TYPE_KEYWORD); /* <- a char array (we're not using C-strings) */
-	hashmap_set(keyword_map, hashmap_str_lit("slice"), TYPE_KEYWORD);
-	/* ^ a structure containing a length and a pointer to a value in an array ^ */
+	char **new_paths = realloc(SRC_PATHS_L, (N_SRC_PATHS_L + 1) * sizeof(char *));
+	if (new_paths == NULL)
+	{
+		flogf(LOG_ERR, stderr, "failed to reallocate input file list\n");
+		exit(4);
+	}
+	SRC_PATHS_L = new_paths;
+	SRC_PATHS_L[N_SRC_PATHS_L++] = path;
 }
 
-void lexer_init(struct str_buf contents_in)
+/* Adds every non-empty line of the file at `list_path` as an input file. */
+static void add_src_paths_from(char *list_path)
+{
+	// the list is kept for as long as the program runs, since the paths point into it
+	struct str_buf list = read_file_to_string(list_path);
+	char *line = list.buf;
+	while (*line)
+	{
+		size_t line_len = strcspn(line, "\n");
+		char *next_line = line + line_len + (line[line_len] == '\n');
+		if (line_len > 0 && line[line_len-1] == '\r')
+			line_len--;
+		line[line_len] = '\0';
+		if (line_len > 0)
+			add_src_path(line);
+		line = next_line;
+	}
+}
+
+static u32 parse_jobs(const char *arg)
+{
+	char *end;
+	unsigned long n = strtoul(arg, &end, 10);
+	if (*arg == '\0' || *end != '\0' || n == 0)
+	{
+		flogf(LOG_ERR, stderr, "invalid number of jobs '%s'\n", arg);
+		print_usage_msg_lexer();
+	}
+	return n;
+}
+
+static u64 parse_cache_size(const char *arg)
+{
+	char *end;
+	u64 size = strtoull(arg, &end, 10);
+	switch (*end) {
+	case 'k': case 'K': size <<= 10; end++; break;
+	case 'm': case 'M': size <<= 20; end++; break;
+	case 'g': case 'G': size <<= 30; end++; break;
+	default: break;
+	}
+	if (end == arg || *end != '\0')
+	{
+		flogf(LOG_ERR, stderr, "invalid cache size '%s'\n", arg);
+		print_usage_msg_lexer();
+	}
+	return size;
+}
+
+static size_t parse_max_diagnostics(const char *arg)
+{
+	char *end;
+	unsigned long long n = strtoull(arg, &end, 10);
+	if (*arg == '\0' || *arg == '-' || *end != '\0')
+	{
+		flogf(LOG_ERR, stderr, "invalid number of diagnostics '%s'\n", arg);
+		print_usage_msg_lexer();
+	}
+	return n;
+}
+
+void parse_args_lexer(s32 argc, char **argv)
+{
+	// pick out the lexer's own options and input files, and leave the rest to
+	// the common parser
+	PROG_NAME = argv[0];
+	char **common_argv = malloc(argc * sizeof(char *));
+	if (common_argv == NULL)
+	{
+		flogf(LOG_ERR, stderr, "failed to allocate argument list\n");
+		exit(3);
+	}
+	s32 common_argc = 0;
+	for (s32 arg_n = 0; arg_n < argc; ++arg_n) {
+		if (arg_n == 0)
+			common_argv[common_argc++] = argv[arg_n];
+		else if (strcmp(argv[arg_n], "--coalesce-literals") == 0)
+			lexer_options |= LEXER_COALESCE_LITERALS;
+		else if (strcmp(argv[arg_n], "--stream") == 0)
+			lexer_options |= LEXER_STREAM_INPUT;
+		else if (strcmp(argv[arg_n], "--format=text") == 0)
+			lexer_options &= ~LEXER_BINARY_OUTPUT;
+		else if (strcmp(argv[arg_n], "--format=bin") == 0)
+			lexer_options |= LEXER_BINARY_OUTPUT;
+		else if (strncmp(argv[arg_n], "--format=", 9) == 0)
+		{
+			flogf(LOG_ERR, stderr, "unknown output format '%s'\n", argv[arg_n]+9);
+			print_usage_msg_lexer();
+		}
+		else if (strcmp(argv[arg_n], "--embed-source") == 0)
+			lexer_options |= LEXER_EMBED_SOURCE;
+		else if (strcmp(argv[arg_n], "--verify-parallel") == 0)
+			lexer_options |= LEXER_VERIFY_PARALLEL;
+		else if (strncmp(argv[arg_n], "--jobs=", 7) == 0)
+			lexer_jobs = parse_jobs(argv[arg_n]+7);
+		else if (strcmp(argv[arg_n], "-j") == 0)
+		{
+			if (arg_n + 1 == argc)
+			{
+				flogf(LOG_ERR, stderr, "missing argument to -j\n");
+				print_usage_msg_lexer();
+			}
+			lexer_jobs = parse_jobs(argv[++arg_n]);
+		}
+		else if (strncmp(argv[arg_n], "-j", 2) == 0 && argv[arg_n][2] != '\0')
+			lexer_jobs = parse_jobs(argv[arg_n]+2);
+		else if (strncmp(argv[arg_n], "--cache-dir=", 12) == 0 && argv[arg_n][12] != '\0')
+			lexer_cache_dir = argv[arg_n]+12;
+		else if (strncmp(argv[arg_n], "--cache-size=", 13) == 0)
+			lexer_cache_size = parse_cache_size(argv[arg_n]+13);
+		else if (strcmp(argv[arg_n], "--cache-stats") == 0)
+			lexer_options |= LEXER_CACHE_STATS;
+		else if (strncmp(argv[arg_n], "--max-diagnostics=", 18) == 0)
+			lexer_max_diagnostics = parse_max_diagnostics(argv[arg_n]+18);
+		else if (strncmp(argv[arg_n], "--files-from=", 13) == 0)
+			add_src_paths_from(argv[arg_n]+13);
+		else if (argv[arg_n][0] != '-' || argv[arg_n][1] == '\0') // "-" is stdin
+			add_src_path(argv[arg_n]);
+		else
+			common_argv[common_argc++] = argv[arg_n];
+	}
+	if (N_SRC_PATHS_L > 0)
+		SRC_PATH_L = SRC_PATHS_L[0];
+	parse_args_preproc(common_argc, common_argv, print_usage_msg_lexer, &SRC_PATH_L, NULL);
+	free(common_argv);
+}
+
+static Lexer default_lexer;
+static bool lexer_is_initialized = false;
+#define IN_STRING() (lx->n_dquotes % 2 == 1)
+#define IN_CHAR() (lx->n_squotes %2 == 1)
+
+/* Builds the line index of `lx->source` the first time it's needed. */
+static const LineIndex *lexer_lines(Lexer *lx)
+{
+	if (lx->lines.starts == NULL)
+		line_index_build(&lx->lines, lx->source.buf, lx->source.len);
+	return &lx->lines;
+}
+
+SourcePos lexer_pos(Lexer *lx, const char *pos)
+{
+	SourcePos ret = line_index_pos(lexer_lines(lx), lx->source.buf, pos - lx->source.buf);
+	ret.line += lx->line_base;
+	return ret;
+}
+
+/* what the lexer reports, see `lexer_diag` */
+enum {
+	DIAG_INVALID_INT_LITERAL_TYPE,
+	DIAG_INT_LITERAL_TRAILING_CHAR,
+	DIAG_INT_LITERAL_NO_DIGITS,
+	DIAG_INT_LITERAL_OVERFLOW,
+	DIAG_UNTERMINATED_COMMENT,
+	DIAG_UNTERMINATED_LITERAL,
+	DIAG_LONG_CHAR_LITERAL,
+	DIAG_UNTERMINATED_CHAR,
+};
+static const char *const diag_messages[] = {
+	[DIAG_INVALID_INT_LITERAL_TYPE] = "invalid integer literal type:\n",
+	[DIAG_INT_LITERAL_TRAILING_CHAR] = "trailing character following %s integer literal:\n",
+	[DIAG_INT_LITERAL_NO_DIGITS] = "%s radix specifier immediately followed by non-%s digit:\n",
+	[DIAG_INT_LITERAL_OVERFLOW] = "%s integer literal doesn't fit in 64 bits:\n",
+	[DIAG_UNTERMINATED_COMMENT] = "unterminated comment:\n",
+	[DIAG_UNTERMINATED_LITERAL] = "unterminated %s literal:\n",
+	[DIAG_LONG_CHAR_LITERAL] = "character literal is longer than one character:\n",
+	[DIAG_UNTERMINATED_CHAR] = "unterminated character literal:\n",
+};
+
+/* Reports the error `kind` for the `len` bytes at `pos`, unless `lx` has
+ * diagnostics turned off: right away, or with the rest of them by
+ * `lexer_report` if they're deferred. Its line is looked up, unless
+ * `line_n` gives it.
+ */
+static void lexer_diag(Lexer *lx, char *pos, size_t len, size_t line_n, u16 kind, const char *arg)
+{
+	if (lx->options & LEXER_QUIET)
+		return;
+	diag_push(&lx->diags, (Diag) { pos - lx->source.buf, len, kind, LOG_ERR, arg, line_n });
+	if (!(lx->options & LEXER_DEFER_DIAGNOSTICS))
+		lexer_report(lx, stderr, false);
+}
+
+void lexer_report(Lexer *lx, FILE *stream, bool last)
+{
+	DiagSource src = {
+		strbuflit(lx->source.buf, lx->source.len, lx->filename), lexer_lines(lx), lx->line_base,
+		diag_messages,
+		(lx->options & LEXER_DEFER_DIAGNOSTICS) ? lexer_max_diagnostics : 0,
+	};
+	diag_report(&lx->diags, stream, &src, last);
+}
+
+/* Prints `substr` like debug_print_pos, for trace output. */
+static void lexer_print_pos(Lexer *lx, FILE *stream, struct str_buf substr, const char *msg_fmt, ...)
 {
-	flogf(LOG_DEBUG, stdout, "initializing lexer...\n");
-	source_code = contents_in;
-	token_start_pos = source_code.buf;
+	const LineIndex *lines = lexer_lines(lx);
+	size_t line = line_index_find(lines, substr.buf - lx->source.buf);
+	va_list arg_list;
+	va_start(arg_list, msg_fmt);
+	vdebug_print_line(stream, substr, lx->source.buf + line_index_start(lines, line),
+			lx->source.buf + line_index_end(lines, line), lx->line_base + line + 1,
+			DEBUG_COLOR, DEBUG_COLOR, LOG_DEBUG, msg_fmt, arg_list);
+	va_end(arg_list);
+}
+
+void lexer_setup(Lexer *lx, struct str_buf source, char *filename)
+{
+	debug_event("initializing lexer...\n");
+	*lx = (Lexer) {0};
+	lx->source = source;
+	lx->filename = filename;
+	lx->token_start_pos = source.buf;
+	lx->options = lexer_options;
+
+	debug_event("successfully initialized lexer.\n");
+}
+
+Lexer *lexer_create(struct str_buf source, char *filename)
+{
+	Lexer *lx = malloc(sizeof(Lexer));
+	if (lx == NULL)
+	{
+		flogf(LOG_ERR, stderr, "failed to allocate lexer context\n");
+		exit(3);
+	}
+	lexer_setup(lx, source, filename);
+	return lx;
+}
+
+void lexer_set_arena(Lexer *lx, Arena *arena)
+{
+	lx->literals.arena = arena;
+	lx->diags.arena = arena;
+}
 
-	flogf(LOG_DEBUG, stdout, "initializing keyword hashmap...\n");
-	keyword_map_init();
+void lexer_cleanup(Lexer *lx)
+{
+	literal_pool_free(&lx->literals);
+	line_index_free(&lx->lines);
+	diag_list_free(&lx->diags);
+}
+
+void lexer_destroy(Lexer *lx)
+{
+	lexer_cleanup(lx);
+	free(lx);
+}
 
+void lexer_init(struct str_buf contents_in)
+{
+	// setting up again would drop what the last source's lexing allocated
+	if (lexer_is_initialized)
+		lexer_cleanup(&default_lexer);
+	lexer_setup(&default_lexer, contents_in, SRC_PATH_L);
 	lexer_is_initialized = true;
-	flogf(LOG_DEBUG, stdout, "successfully initialized lexer.\n");
 }
 
 u32 errflags = 0;
@@ -81,154 +336,392 @@ bool is_null_token(Token token)
 	return (token.type == FileEndToken);
 }
 
+#define IS_KEYWORD(str, lit) (memcmp((str), (lit), sizeof(lit) - 1) == 0)
+
+/* Dispatches on length and first character, so most identifiers are
+ * rejected after two compares without touching the rest of the string.
+ */
 TokenSubType keyword_type(struct str_buf ident)
 {
-	uintptr_t ret = 0;
-	if (hashmap_get(keyword_map, ident.buf, ident.len, &ret) == 0)
-		return NORMAL_IDENTIFIER;
-	return (TokenSubType) ret;
+	const char *s = ident.buf;
+	switch (ident.len) {
+	case 2: // s8, u8
+		if ((s[0] == 's' || s[0] == 'u') && s[1] == '8')
+			return TYPE_KEYWORD;
+		break;
+	case 3: // s16, s32, s64, u16, u32, u64
+		if ((s[0] == 's' || s[0] == 'u')
+		 && ((s[1] == '1' && s[2] == '6')
+		  || (s[1] == '3' && s[2] == '2')
+		  || (s[1] == '6' && s[2] == '4')))
+			return TYPE_KEYWORD;
+		break;
+	case 4:
+		if (s[0] == 'f' && IS_KEYWORD(s, "func"))
+			return FUNC_KEYWORD;
+		if (s[0] == 'c' && IS_KEYWORD(s, "char"))
+			return TYPE_KEYWORD;
+		break;
+	case 5:
+		// a structure containing a length and a pointer to a value in an array
+		if (s[0] == 's' && IS_KEYWORD(s, "slice"))
+			return TYPE_KEYWORD;
+		break;
+	case 6:
+		if (s[0] == 'r' && IS_KEYWORD(s, "return"))
+			return RETURN_KEYWORD;
+		if (s[0] == 'o' && IS_KEYWORD(s, "obtain"))
+			return RESERVED_KEYWORD;
+		if (s[0] == 's' && IS_KEYWORD(s, "string")) // <- a char array (we're not using C-strings)
+			return TYPE_KEYWORD;
+		break;
+	}
+	return NORMAL_IDENTIFIER;
+}
+
+bool token_int_value(Token token, u64 *out)
+{
+	if (token.type != IntegerLiteralToken)
+		return false;
+	DigitRadix radix;
+	switch (token.subtype) {
+	case DEC_INT_LITERAL: radix = DIGITS_DEC; break;
+	case HEX_INT_LITERAL: radix = DIGITS_HEX; break;
+	case OCT_INT_LITERAL: radix = DIGITS_OCT; break;
+	case BIN_INT_LITERAL: radix = DIGITS_BIN; break;
+	default:
+		return false;
+	}
+	// the prefix was already skipped, so the text is just the digits
+	return literal_parse_int(token.value.buf, token.value.len, radix, out);
 }
 
-bool skipped_int_literal_prefix = false;
+/* every keyword keyword_type() knows of, for lexer_fingerprint */
+static const char *const known_keywords[] = {
+	"s8", "s16", "s32", "s64", "u8", "u16", "u32", "u64",
+	"func", "char", "slice", "return", "obtain", "string",
+};
+
+u64 lexer_fingerprint(u32 options)
+{
+	u64 h = hash_bytes(LEXER_VERSION, sizeof(LEXER_VERSION), 0);
+	options &= LEXER_COALESCE_LITERALS | LEXER_SKIP_COMMENTS;
+	h = hash_bytes(&options, sizeof(options), h);
+	u8 tracing = TRACING; // the trace build prints between tokens
+	h = hash_bytes(&tracing, 1, h);
+	h = hash_bytes(lex_char_class, sizeof(lex_char_class), h);
+	h = hash_bytes(lex_op_column, sizeof(lex_op_column), h);
+	h = hash_bytes(lex_op_next, sizeof(lex_op_next), h);
+	for (size_t i = 0; i < sizeof(lex_op_accept)/sizeof(*lex_op_accept); ++i)
+	{
+		u32 accept[3] = { lex_op_accept[i].len, lex_op_accept[i].type, lex_op_accept[i].subtype };
+		h = hash_bytes(accept, sizeof(accept), h);
+	}
+	for (size_t i = 0; i < sizeof(known_keywords)/sizeof(*known_keywords); ++i)
+	{
+		struct str_buf word = strbuflit((char *) known_keywords[i], strlen(known_keywords[i]), NULL);
+		u32 subtype = keyword_type(word);
+		h = hash_bytes(word.buf, word.len, h);
+		h = hash_bytes(&subtype, sizeof(subtype), h);
+	}
+	return h;
+}
 
 #include "is_digit.c"
 
-size_t int_literal_valid_length(char *lit_start, TokenSubType *subtype_out)
+size_t int_literal_valid_length(Lexer *lx, char *lit_start, TokenSubType *subtype_out)
 {
-	bool (*is_digit) (char c);
-	char literal_type_string[11+1];
+	DigitRadix radix;
+	const char *literal_type_string;
 	if (strncmp(lit_start, "0d", 2) == 0)
 	{
 		*subtype_out = DEC_INT_LITERAL;
-		is_digit = is_dec_digit;
-		skipped_int_literal_prefix = true;
-		strncpy(literal_type_string, "decimal", 8);
+		radix = DIGITS_DEC;
+		lx->skipped_int_literal_prefix = true;
+		literal_type_string = "decimal";
 	} else if (strncmp(lit_start, "0x", 2) == 0)
 	{
 		*subtype_out = HEX_INT_LITERAL;
-		is_digit = is_hex_digit;
-		skipped_int_literal_prefix = true;
-		strncpy(literal_type_string, "hexadecimal", 12);
+		radix = DIGITS_HEX;
+		lx->skipped_int_literal_prefix = true;
+		literal_type_string = "hexadecimal";
 	} else if (strncmp(lit_start, "0o", 2) == 0)
 	{
 		*subtype_out = OCT_INT_LITERAL;
-		is_digit = is_oct_digit;
-		skipped_int_literal_prefix = true;
-		strncpy(literal_type_string, "octal", 6);
+		radix = DIGITS_OCT;
+		lx->skipped_int_literal_prefix = true;
+		literal_type_string = "octal";
 	} else if (strncmp(lit_start, "0b", 2) == 0)
 	{
 		*subtype_out = BIN_INT_LITERAL;
-		is_digit = is_bin_digit;
-		skipped_int_literal_prefix = true;
-		strncpy(literal_type_string, "binary", 7);
+		radix = DIGITS_BIN;
+		lx->skipped_int_literal_prefix = true;
+		literal_type_string = "binary";
 	} else if (*lit_start == '0' && isalpha(*(lit_start+1)))
 	{
-		debug_print_pos(stderr, strbuflit(lit_start, 2, SRC_PATH_L), source_code.buf, line_n,
-				ERR_COLOR, ERR_COLOR,
-				LOG_ERR, "invalid integer literal type:\n");
+		lexer_diag(lx, lit_start, 2, 0, DIAG_INVALID_INT_LITERAL_TYPE, NULL);
 		*subtype_out = ERROR_TOKEN;
-		seterr(INVALID_INT_LITERAL);
+		lexer_seterr(lx, INVALID_INT_LITERAL);
 		return 0;
 	} else if (*lit_start != '0' && is_dec_digit(*lit_start))
 	{
 		*subtype_out = DEC_INT_LITERAL;
-		is_digit = is_dec_digit;
-		skipped_int_literal_prefix = false;
-		strncpy(literal_type_string, "decimal", 8);
+		radix = DIGITS_DEC;
+		lx->skipped_int_literal_prefix = false;
+		literal_type_string = "decimal";
 	} else 
 		return 0;
 
-	char *start_pos = lit_start + ((skipped_int_literal_prefix) ? 2 : 0);
-	char *pos = start_pos;
-	while ((*is_digit)(*pos)) 
-		pos++;
+	char *start_pos = lit_start + ((lx->skipped_int_literal_prefix) ? 2 : 0);
+	char *pos = scan_digits(start_pos, lx->source.buf + lx->source.len, radix);
 	size_t ret_len = pos - start_pos;
+	if (lx->more_input && pos == lx->source.buf + lx->source.len)
+	{
+		// the digits might go on in the next chunk
+		lx->need_input = true;
+		return 0;
+	}
 
 	if (ret_len > 0 && isalnum(*pos))
 	{
-		debug_print_pos(stderr, strbuflit(pos, 1, SRC_PATH_L), source_code.buf, line_n,
-				ERR_COLOR, ERR_COLOR,
-				LOG_ERR, "trailing character following %s integer literal:\n",
-				literal_type_string);
-		seterr(INT_LITERAL_HAS_TRAILING_CHAR);
+		lexer_diag(lx, pos, 1, 0, DIAG_INT_LITERAL_TRAILING_CHAR, literal_type_string);
+		lexer_seterr(lx, INT_LITERAL_HAS_TRAILING_CHAR);
 	} else if (ret_len == 0 && isxdigit(*pos+1) && *subtype_out != ERROR_TOKEN)
 	{
-		debug_print_pos(stderr, strbuflit(pos, 1, SRC_PATH_L), source_code.buf, line_n,
-				ERR_COLOR, ERR_COLOR,
-				LOG_ERR, "%s radix specifier immediately followed by non-%s digit:\n",
-				literal_type_string, literal_type_string);
-		seterr(INT_LITERAL_HAS_NO_VALID_DIGITS);
+		lexer_diag(lx, pos, 1, 0, DIAG_INT_LITERAL_NO_DIGITS, literal_type_string);
+		lexer_seterr(lx, INT_LITERAL_HAS_NO_VALID_DIGITS);
+	}
+
+	// the value isn't kept, as `token_int_value` gets it back from the text
+	u64 value;
+	if (ret_len > 0 && !literal_parse_int(start_pos, ret_len, radix, &value))
+	{
+		lexer_diag(lx, start_pos, ret_len, 0, DIAG_INT_LITERAL_OVERFLOW, literal_type_string);
+		lexer_seterr(lx, INT_LITERAL_OVERFLOW);
 	}
 
 	return ret_len;
 }
 
-Token next_token(void)
+/* Returns the end of the line or block comment starting at `p`, or NULL
+ * (after reporting it) if it's an unterminated block comment. A line
+ * comment ends before its newline.
+ * Also returns NULL, setting `need_input`, if the comment reaches the end of
+ * a chunk with more input to come.
+ */
+static char *skip_comment(Lexer *lx, char *p)
 {
-	if (stream_will_terminate)
-		return NULL_TOKEN;
+	char *src_end = lx->source.buf + lx->source.len;
+	if (p[1] == '/')
+	{
+		char *line_end = p + 2 + strcspn(p + 2, "\n");
+		if (lx->more_input && line_end == src_end)
+		{
+			lx->need_input = true;
+			return NULL;
+		}
+		return line_end;
+	}
 
-	if (!lexer_is_initialized) {
-		flogf(LOG_ERR, stderr, "`lexer_init` must be called prior to accessing the token stream.\n");
-		seterr(UNINITIALIZED_LEXER);
-		return NULL_TOKEN;
+	char *pos;
+	for (pos = p + 2; *pos != '\0'; ++pos)
+		if (pos[0] == '*' && pos[1] == '/')
+			return pos + 2;
+	if (lx->more_input && pos == src_end)
+	{
+		lx->need_input = true;
+		return NULL;
+	}
+	lexer_diag(lx, p, 2, 0, DIAG_UNTERMINATED_COMMENT, NULL);
+	lexer_seterr(lx, UNTERMINATED_COMMENT);
+	return NULL;
+}
+
+/* Lexes the literal opened by the quote at `ret->value.buf` as a single
+ * token holding its body, and returns how many bytes after the body belong
+ * to it (1 for the closing quote, 0 if the literal is unterminated).
+ */
+static size_t lex_coalesced_literal(Lexer *lx, Token *ret)
+{
+	char *open = ret->value.buf, *body = open + 1;
+	char *src_end = lx->source.buf + lx->source.len;
+	bool is_string = (*open == '"');
+
+	// the first structural quote after the opening one closes the literal;
+	// like the per-byte mode, a literal also stops at a NUL
+	char *close = NULL, *stop = NULL;
+	structural_index(&lx->sidx, body, src_end, is_string ? SIDX_IN_STRING : SIDX_IN_CHAR, false);
+	while (close == NULL && stop == NULL)
+	{
+		if (lx->sidx.window_start == lx->sidx.window_end)
+		{
+			stop = src_end;
+			break;
+		}
+		char *nul = memchr(lx->sidx.window_start, '\0', lx->sidx.window_end - lx->sidx.window_start);
+		char *limit = (nul != NULL) ? nul : lx->sidx.window_end;
+		for (size_t b = 0; close == NULL && lx->sidx.window_start + b*64 < limit; ++b)
+		{
+			char *block = lx->sidx.window_start + b*64;
+			u64 in_limit = (limit - block >= 64) ? ~0ull : (1ull << (limit - block)) - 1;
+			u64 quotes = lx->sidx.quote_bits[b] & in_limit;
+			u64 escapes = lx->sidx.escape_bits[b] & in_limit;
+			if (quotes != 0)
+			{
+				close = block + __builtin_ctzll(quotes);
+				// only the escapes before the closing quote are part of the body
+				escapes &= (quotes & -quotes) - 1;
+			}
+			for (; escapes != 0; escapes &= escapes - 1)
+				literal_pool_push_escape(&lx->literals, block + __builtin_ctzll(escapes) - body);
+		}
+		if (close == NULL && nul != NULL)
+			stop = nul;
+		else if (close == NULL)
+			structural_next_window(&lx->sidx);
+	}
+	// force the next lookup to re-index, the window no longer matches the lexer's state
+	lx->sidx.window_start = lx->sidx.window_end = NULL;
+	if (close == NULL && stop == src_end && lx->more_input)
+	{
+		// the rest of the literal is in the next chunk
+		lx->need_input = true;
+		return 0;
+	}
+
+	ret->type = is_string ? StringLiteralToken : CharLiteralToken;
+	ret->subtype = NOT_IDENTIFIER;
+	ret->value.buf = body;
+	ret->value.len = ((close != NULL) ? close : stop) - body;
+	lx->token_start_pos = body;
+
+	size_t decoded_len = literal_pool_add(&lx->literals, ret->value, body - lx->source.buf);
+
+	if (close == NULL)
+	{
+		lexer_diag(lx, open, 1, 0, DIAG_UNTERMINATED_LITERAL, is_string ? "string" : "character");
+		ret->subtype = ERROR_TOKEN;
+		lexer_seterr(lx, UNTERMINATED_LITERAL);
+		return 0;
+	}
+	if (!is_string && decoded_len > 1)
+	{
+		// diagnostics can only underline a single line
+		char *line_end = memchr(open, '\n', ret->value.len + 2);
+		size_t span = (line_end != NULL) ? (size_t) (line_end - open) : ret->value.len + 2;
+		lexer_diag(lx, open, span, 0, DIAG_LONG_CHAR_LITERAL, NULL);
+		ret->subtype = ERROR_TOKEN;
+		lexer_seterr(lx, EXCESSIVE_CHAR_LITERAL);
 	}
+	return 1;
+}
+
+bool lexer_literal(const Lexer *lx, Token token, LiteralInfo *out)
+{
+	if (token.type != StringLiteralToken && token.type != CharLiteralToken)
+		return false;
+	return literal_pool_find(&lx->literals, token.value, token.value.buf - lx->source.buf, out);
+}
 
-	token_n++;
+/* Lexes one token into `*out`. Returns false (leaving `*out` untouched)
+ * once the end of the source has been reached, or if the source is a chunk
+ * and the token might continue past it (setting `need_input`).
+ */
+static bool lex_token(Lexer *lx, Token *out)
+{
+	lx->token_n++;
 
-	flogf(LOG_DEBUG, stdout, "accessing token starting from char %zu\n", token_start_pos - source_code.buf);
+	trace("accessing token starting from char %zu\n", lx->token_start_pos - lx->source.buf);
 
 	Token ret = {0};
-	ret.value.buf = token_start_pos;
+	size_t skip_after = 0; // bytes after the value that belong to the token
+	ret.value.buf = lx->token_start_pos;
 	ret.value.len = 1;
-	ret.value.capacity = (source_code.buf + source_code.len) - token_start_pos;
-	flogf(LOG_DEBUG, stdout, "Set initial values for token #%d.\n", token_n);
+	ret.value.capacity = (lx->source.buf + lx->source.len) - lx->token_start_pos;
+	trace("Set initial values for token #%zu.\n", lx->token_n);
 
-	// skip any whitespace at the start
-	while (!IN_STRING() && !IN_CHAR() && isspace(*ret.value.buf))
+	// skip any whitespace (and comments) at the start
+	if (!IN_STRING() && !IN_CHAR())
 	{
-		if (*ret.value.buf == '\n')
-			line_n++;
-		token_start_pos++;
-		ret.value.buf++;
+		char *src_end = lx->source.buf + lx->source.len;
+		ret.value.buf = scan_space(ret.value.buf, src_end);
+		while ((lx->options & LEXER_SKIP_COMMENTS) && ret.value.buf[0] == '/'
+		    && (ret.value.buf[1] == '/' || ret.value.buf[1] == '*'))
+		{
+			char *comment_end = skip_comment(lx, ret.value.buf);
+			if (comment_end == NULL && lx->need_input)
+			{
+				lx->token_start_pos = ret.value.buf;
+				goto need_input;
+			}
+			if (comment_end == NULL)
+			{
+				lx->token_start_pos = ret.value.buf + strlen(ret.value.buf);
+				return false;
+			}
+			lx->comment_bytes += comment_end - ret.value.buf;
+			ret.value.buf = scan_space(comment_end, src_end);
+		}
+		lx->token_start_pos = ret.value.buf;
 	}
+	lx->token_pos = ret.value.buf;
+	// every token up to a fixed lookahead is decided within the chunk
+	if (lx->more_input && ret.value.buf >= lx->refill_at)
+		goto need_input;
 	if (*ret.value.buf == '\0')
-		return NULL_TOKEN;
-	flogf(LOG_DEBUG, stdout, "Skipped initial whitespace for token #%d.\n", token_n);
-	struct str_buf escaped_5_chars = dbg_escape_str(strbuflit(ret.value.buf, MIN(5, ret.value.capacity), SRC_PATH_L));
-	flogf(LOG_DEBUG, stdout, "Next 5 (valid) chars of token #%d: '%.*s'\n", token_n,
-			escaped_5_chars.len, escaped_5_chars.buf);
-	freetmp();
-
-	char first_char = *ret.value.buf;
-	if (first_char == '"' || first_char == '\'') {
-		goto check_char_string;
+		return false;
+	trace("Skipped initial whitespace for token #%zu.\n", lx->token_n);
+	if (TRACING && FLAG_SET(DEBUG))
+	{
+		struct str_buf escaped_5_chars = dbg_escape_str(strbuflit(ret.value.buf, MIN(5, ret.value.capacity), lx->filename));
+		trace("Next 5 (valid) chars of token #%zu: '%.*s'\n", lx->token_n,
+				(int) escaped_5_chars.len, escaped_5_chars.buf);
+		freetmp();
 	}
 
-	flogf(LOG_DEBUG, stdout, "Checking if token #%d constitutes the beginning of an escape sequence.\n", token_n);
-
-	// check if first_char constitutes the start of an escape sequence
-	if (first_char == '\\' && (IN_STRING() || IN_CHAR()))
+	char first_char = *ret.value.buf;
+	if (IN_STRING() || IN_CHAR())
 	{
-		if ((++n_consec_backslashes) % 2 == 1)
+		// inside a literal, the structural index says what each byte is
+		if (!structural_covers(&lx->sidx, ret.value.buf))
+			structural_index(&lx->sidx, ret.value.buf, lx->source.buf + lx->source.len,
+					IN_STRING() ? SIDX_IN_STRING : SIDX_IN_CHAR, lx->is_escaped_char);
+		SidxClass byte_class = structural_class(&lx->sidx, ret.value.buf);
+		lx->is_escaped_char = (byte_class == SIDX_ESCAPE);
+
+		if (byte_class == SIDX_ESCAPE)
 		{
-			is_escaped_char = true;
 			ret.value.len = 1;
 			ret.type = EscapeCodeStartToken;
 			ret.subtype = NOT_IDENTIFIER;
-			debug_print_pos(stdout, strbuflit(ret.value.buf, 1, SRC_PATH_L),
-					source_code.buf, line_n, 
-					DEBUG_COLOR, DEBUG_COLOR,
-					LOG_DEBUG, "non-escaped backslash in string/char:\n");
+			if (TRACING)
+				lexer_print_pos(lx, stdout, strbuflit(ret.value.buf, 1, lx->filename),
+						"non-escaped backslash in string/char:\n");
 
 			goto func_end;
 		}
+		// the closing quote
+		if (byte_class == SIDX_QUOTE)
+			goto check_char_string;
+		// an escaped quote or one of the other kind is left as a MiscToken
+		if (first_char == '"' || first_char == '\'')
+			goto func_end;
+	}
+	if (first_char == '"' || first_char == '\'') {
+		if (lx->options & LEXER_COALESCE_LITERALS)
+		{
+			skip_after = lex_coalesced_literal(lx, &ret);
+			if (lx->need_input)
+				goto need_input;
+			goto func_end;
+		}
+		goto check_char_string;
 	}
 
-	flogf(LOG_DEBUG, stdout, "Checking if token #%d is in a string.\n", token_n);
+	trace("Checking if token #%zu is in a string.\n", lx->token_n);
 	// check if the character is within a string literal
 	if (IN_STRING()) {
-		flogf(LOG_DEBUG, stdout, "Token #%d is in a string.\n", token_n);
+		trace("Token #%zu is in a string.\n", lx->token_n);
 		ret.value.len = 1;
 		ret.type = WithinStringToken;
 		ret.subtype = NOT_IDENTIFIER;
@@ -236,207 +729,163 @@ Token next_token(void)
 		goto func_end;
 	}
 
-	flogf(LOG_DEBUG, stdout, "Checking if token #%d is in a character.\n", token_n);
+	trace("Checking if token #%zu is in a character.\n", lx->token_n);
 	// check if the character is within a character literal
 	if (IN_CHAR()) {
-		flogf(LOG_DEBUG, stdout, "Token #%d is in a character.\n", token_n);
+		trace("Token #%zu is in a character.\n", lx->token_n);
 		ret.value.len = 1;
 		ret.type = WithinCharToken;
 		ret.subtype = NOT_IDENTIFIER;
-		if (++in_char_for > 1)
+		if (++lx->in_char_for > 1)
 		{
-			flogf(LOG_DEBUG, stdout, "Token #%d makes the character literal too long.\n", token_n);
-			debug_print_pos(stderr, strbuflit(chr_start, 1, SRC_PATH_L),
-					source_code.buf, chr_start_line,
-					ERR_COLOR, ERR_COLOR,
-					LOG_ERR, "unterminated character literal:\n");
-			seterr(EXCESSIVE_CHAR_LITERAL);
+			trace("Token #%zu makes the character literal too long.\n", lx->token_n);
+			lexer_diag(lx, lx->chr_start, 1, lx->chr_start_line, DIAG_UNTERMINATED_CHAR, NULL);
+			lexer_seterr(lx, EXCESSIVE_CHAR_LITERAL);
 		}
 
 		goto func_end;
 	}
 
-	// check if token is an integer literal
-	TokenSubType int_lit_type;
-	size_t int_lit_len = int_literal_valid_length(ret.value.buf, &int_lit_type);
-	if (int_lit_len > 0)
+	switch (lex_char_class[(u8) first_char]) {
+	case CC_DIGIT:
 	{
-		if (!geterr(INVALID_INT_LITERAL))
-			flogf(LOG_DEBUG, stdout, "token #%d is a valid integer literal.\n", token_n);
+		// check if token is an integer literal
+		TokenSubType int_lit_type;
+		size_t int_lit_len = int_literal_valid_length(lx, ret.value.buf, &int_lit_type);
+		if (lx->need_input)
+			goto need_input;
+		if (int_lit_len == 0)
+			break;
+		if (!lexer_geterr(lx, INVALID_INT_LITERAL))
+			trace("token #%zu is a valid integer literal.\n", lx->token_n);
 		ret.type = IntegerLiteralToken;
 		ret.value.len = int_lit_len;
-		if (skipped_int_literal_prefix) {
-			flogf(LOG_DEBUG, stdout, "token #%d has a 2-character prefix that has been skipped.\n", token_n);
-			token_start_pos += 2;
+		if (lx->skipped_int_literal_prefix) {
+			trace("token #%zu has a 2-character prefix that has been skipped.\n", lx->token_n);
+			lx->token_start_pos += 2;
 			ret.value.buf += 2;
 		}
 		ret.subtype = int_lit_type;
 		goto func_end;
 	}
-
-	// check if token is an identifier
-	flogf(LOG_DEBUG, stdout, "Checking if token #%d contains a valid identifier...\n", token_n);
-
-	// get identifier length
-	bool can_be_identifier = can_be_identifier = (isalpha(*ret.value.buf) || *ret.value.buf == '_');
-	char *pos = ret.value.buf+1;
-	while (isalnum(*pos) || *pos == '_')
-		pos++;
-
-	if (can_be_identifier && pos > ret.value.buf)
+	case CC_IDENT:
 	{
-		flogf(LOG_DEBUG, stdout, "token #%d is a valid identifier.\n", token_n);
+		// get identifier length
+		char *pos = scan_ident(ret.value.buf+1, lx->source.buf + lx->source.len);
+		if (lx->more_input && pos == lx->source.buf + lx->source.len)
+			goto need_input;
+
+		trace("token #%zu is a valid identifier.\n", lx->token_n);
 		ret.type = IdentifierToken;
 		ret.value.len = pos - ret.value.buf;
 		ret.subtype = keyword_type(ret.value);
 		goto func_end;
 	}
-	
-	if (strncmp(ret.value.buf, "...", 3) == 0)
+	case CC_OPERATOR:
 	{
-		ret.type = VariableArgumentIndicatorToken;
-		ret.subtype = NOT_IDENTIFIER;
-		ret.value.len = 3;
+		// walk the operator DFA for as long as it has transitions, then
+		// take the longest lexeme that was accepted along the way
+		u8 state = 0, accepted = 0;
+		for (char *pos = ret.value.buf; (state = lex_op_next[state][lex_op_column[(u8) *pos]]) != 0; ++pos)
+			if (lex_op_accept[state].len != 0)
+				accepted = state;
+		if (accepted == 0)
+			break;
+		ret.type = lex_op_accept[accepted].type;
+		ret.subtype = lex_op_accept[accepted].subtype;
+		ret.value.len = lex_op_accept[accepted].len;
 		goto func_end;
 	}
-
-	if (strncmp(ret.value.buf, "->", 2) == 0)
-	{
-		ret.type = ReturnTypeIndicatorToken;
-		ret.subtype = NOT_IDENTIFIER;
-		ret.value.len = 2;
-		goto func_end;
-	}
-	if (strncmp(ret.value.buf, ":=", 2) == 0)
-	{
-		ret.type = VarTypeInferInitToken;
-		ret.subtype = NOT_IDENTIFIER;
-		ret.value.len = 2;
-		goto func_end;
-	}
-	if ((strncmp(ret.value.buf, "==", 2) == 0)
-	 || (strncmp(ret.value.buf, "!=", 2) == 0)
-	 || (strncmp(ret.value.buf, "<=", 2) == 0)
-	 || (strncmp(ret.value.buf, ">=", 2) == 0)
-	 || (strncmp(ret.value.buf, "+=", 2) == 0)
-	 || (strncmp(ret.value.buf, "-=", 2) == 0)
-	 || (strncmp(ret.value.buf, "*=", 2) == 0)
-	 || (strncmp(ret.value.buf, "/=", 2) == 0)
-	 || (strncmp(ret.value.buf, "%=", 2) == 0)
-	 || (strncmp(ret.value.buf, "&=", 2) == 0)
-	 || (strncmp(ret.value.buf, "|=", 2) == 0)
-	 || (strncmp(ret.value.buf, "^=", 2) == 0)
-	 || (strncmp(ret.value.buf, "~=", 2) == 0)
-	 || (strncmp(ret.value.buf, "<<", 2) == 0)
-	 || (strncmp(ret.value.buf, ">>", 2) == 0)
-	 ) {
-		ret.value.len = 2;
-		ret.type = OperatorToken;
-		ret.subtype = NOT_IDENTIFIER;
-		goto func_end;
-	}
-
-	switch (*ret.value.buf) {
-	case '{':
-		ret.type = StartBlockToken;
-		ret.subtype = GROUPING_TOKEN;
-		goto func_end;
-	case '}':
-		ret.type = EndBlockToken;
-		ret.subtype = GROUPING_TOKEN;
-		goto func_end;
-	case '[':
-		ret.type = StartBracketToken;
-		ret.subtype = GROUPING_TOKEN;
-		goto func_end;
-	case ']':
-		ret.type = EndBracketToken;
-		ret.subtype = GROUPING_TOKEN;
-		goto func_end;
-	case '(':
-		ret.type = StartParenToken;
-		ret.subtype = GROUPING_TOKEN;
-		goto func_end;
-	case ')':
-		ret.type = EndParenToken;
-		ret.subtype = GROUPING_TOKEN;
-		goto func_end;
-	case ',':
-		ret.type = ItemSeparatorToken;
-		ret.subtype = NOT_IDENTIFIER;
-		goto func_end;
-	case ';':
-		ret.type = EndStatementToken;
-		ret.subtype = NOT_IDENTIFIER;
-		goto func_end;
-	case '=':
-	case '!':
-	case '<':
-	case '>':
-	case '+':
-	case '-':
-	case '*':
-	case '/':
-	case '%':
-	case '@':
-	case '&':
-	case '|':
-	case '^':
-	case '~':
-	case ':':
-	case '?':
-	case '.':
-		ret.type = OperatorToken;
-		ret.subtype = NOT_IDENTIFIER;
-		goto func_end;
 	}
 
 check_char_string:
-	// do this at the end so that the following call will be able to use these values
-	if (first_char == '"' && !IS_ESCAPED() && !IN_CHAR())
+	// only reached for quotes that open or close a literal. The structural
+	// index is rebuilt from each opening quote, since whatever it indexed past
+	// the last literal (e.g. quotes in comments) may not match the lexer
+	if (!IN_STRING() && !IN_CHAR())
+		lx->sidx.window_start = lx->sidx.window_end = NULL;
+	if (first_char == '"')
 	{
-		if (++n_dquotes % 2 == 0)
+		if (++lx->n_dquotes % 2 == 0)
 		{
 			// string end
-			str_start = NULL;
-			str_start_line = 0;
+			lx->str_start = NULL;
 			ret.type = EndStringToken;
 		} else
 		{
 			// string start
-			str_start = ret.value.buf;
-			str_start_line = line_n;
+			lx->str_start = ret.value.buf;
 			ret.type = StartStringToken;
 		}
 		goto func_end;
 	}
-	if (first_char == '\'' && !IS_ESCAPED() && !IN_STRING())
+	if (first_char == '\'')
 	{
-		if (++n_squotes % 2 == 0)
+		if (++lx->n_squotes % 2 == 0)
 		{
-			// char end
-			chr_start = NULL;
-			chr_start_line = 0;
+			// char end; nothing is pending outside of the literal, which
+			// parallel lexing and re-lexing rely on to resume here
+			lx->chr_start = NULL;
+			lx->chr_start_line = 0;
+			lx->in_char_for = 0;
 			ret.type = EndCharToken;
 		} else
 		{
 			// char start
-			str_start = ret.value.buf;
-			str_start_line = line_n;
+			lx->chr_start = ret.value.buf;
+			lx->chr_start_line = 0;
 			ret.type = StartCharToken;
 		}
 		goto func_end;
 	}
-	flogf(LOG_DEBUG, stdout, "Properly incremented quote counters for token #%d.\n", token_n);
 
+func_end:
+	lx->token_start_pos += ret.value.len + skip_after;
+	lx->stream_will_terminate = (lx->token_start_pos > (lx->source.buf + lx->source.len));
 
+	*out = ret;
+	return true;
 
-	if (!(first_char == '\\' && (IN_STRING() || IN_CHAR())))
-		n_consec_backslashes = 0;
+need_input:
+	// nothing about this token has been kept, it's lexed again after a refill
+	lx->token_n--;
+	lx->need_input = true;
+	return false;
+}
 
-func_end:
-	token_start_pos += ret.value.len;
-	stream_will_terminate = (token_start_pos > (source_code.buf + source_code.len));
+Token lexer_next(Lexer *lx)
+{
+	Token ret;
+	if (lx->stream_will_terminate || !lex_token(lx, &ret))
+		return NULL_TOKEN;
+	return ret;
+}
+
+size_t lexer_next_batch(Lexer *lx, Token *out, size_t cap)
+{
+	if (lx->stream_will_terminate)
+		return 0;
+
+	size_t n = 0;
+	u32 errflags_before = lx->errflags;
+	while (n < cap && lex_token(lx, &out[n]))
+	{
+		n++;
+		if (lx->errflags != errflags_before || lx->stream_will_terminate)
+			break;
+	}
+	return n;
+}
+
+Token next_token(void)
+{
+	if (!lexer_is_initialized) {
+		flogf(LOG_ERR, stderr, "`lexer_init` must be called prior to accessing the token stream.\n");
+		seterr(UNINITIALIZED_LEXER);
+		return NULL_TOKEN;
+	}
 
+	Token ret = lexer_next(&default_lexer);
+	errflags = default_lexer.errflags;
 	return ret;
 }
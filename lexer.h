@@ -3,6 +3,10 @@
 
 #include "util.h"
 #include "types.h"
+#include "structural.h"
+#include "diag.h"
+#include "line_index.h"
+#include "literal.h"
 
 /* maybe token list is stored as a doubly-linked list? 
  * supposedly implementing it as a stream is quite helpful.
@@ -14,10 +18,12 @@ typedef enum {
       WithinStringToken = 0x09, /* any non-EscapeCode character between a StartString and EndString token */
 	EscapeCodeStartToken, /* a backslash that is the nth consecutive backslash iff n is odd */
       EscapeCodeToken, /* any character within a string that is part of an escape sequence */
+	StringLiteralToken = 0x0C, /* the body of a whole string literal (LEXER_COALESCE_LITERALS only) */
       EndStringToken = 0x10, /* '"' */
       StartCharToken = 0x14, /* '\''*/
       WithinCharToken = 0x15, /* any character between StartChar and EndChar tokens. */
       EndCharToken = 0x18, /* '\'' */
+	CharLiteralToken = 0x19, /* the body of a whole char literal (LEXER_COALESCE_LITERALS only) */
       VarTypeInferInitToken = 0x1C, /* :=  (RESERVED) */
       OperatorToken = 0x20, /* e.g. *, +, @ */
       StartBlockToken = 0x24, /* { */
@@ -51,16 +57,71 @@ typedef enum {
 	BIN_INT_LITERAL,
 } TokenSubType;
 
+/* error flags of the default lexer context (see `lexer_init`/`next_token`) */
+extern u32 errflags;
 #define seterr(f) (errflags |= (1<<(f)))
 #define geterr(f) ((errflags & (1<<(f))) != 0)
+#define lexer_seterr(lx, f) ((lx)->errflags |= (1<<(f)))
+#define lexer_geterr(lx, f) (((lx)->errflags & (1<<(f))) != 0)
 enum {
 	UNINITIALIZED_LEXER,
 	INVALID_INT_LITERAL,
 	INT_LITERAL_HAS_TRAILING_CHAR,
 	INT_LITERAL_HAS_NO_VALID_DIGITS,
 	EXCESSIVE_CHAR_LITERAL,
+	UNTERMINATED_LITERAL,
+	UNTERMINATED_COMMENT,
+	INT_LITERAL_OVERFLOW,
 };
 
+/* lexer options, see `Lexer.options` */
+enum {
+	/* emit each string/char literal as one String/CharLiteralToken holding
+	 * its body (without the quotes) instead of one token per byte; its
+	 * escapes and decoded value are available through `lexer_literal`
+	 */
+	LEXER_COALESCE_LITERALS = (1<<0),
+	/* skip "//" and block comments outside of literals like whitespace */
+	LEXER_SKIP_COMMENTS = (1<<1),
+	/* read the input through a `LexerStream` (only used by lexer_main) */
+	LEXER_STREAM_INPUT = (1<<2),
+	/* don't print diagnostics (errors are still flagged), e.g. while lexing
+	 * speculatively
+	 */
+	LEXER_QUIET = (1<<3),
+	/* check parallel lexing against serial lexing (only used by lexer_main) */
+	LEXER_VERIFY_PARALLEL = (1<<4),
+	/* write tokens as a token file (see token_file.h), optionally with the
+	 * sources (only used by lexer_main)
+	 */
+	LEXER_BINARY_OUTPUT = (1<<5),
+	LEXER_EMBED_SOURCE = (1<<6),
+	/* print the token cache's counters (only used by lexer_main) */
+	LEXER_CACHE_STATS = (1<<7),
+	/* keep diagnostics until `lexer_report` instead of printing each one as
+	 * it's found
+	 */
+	LEXER_DEFER_DIAGNOSTICS = (1<<8),
+};
+/* options given on the command line, used by every lexer set up afterwards */
+extern u32 lexer_options;
+/* every input file given on the command line (SRC_PATH_L is the first one) */
+extern char **SRC_PATHS_L;
+extern size_t N_SRC_PATHS_L;
+/* threads to lex multiple input files (or a large one) on (-j), 0 for one per CPU */
+extern u32 lexer_jobs;
+/* the token cache to use (--cache-dir, see token_cache.h), or NULL */
+extern char *lexer_cache_dir;
+extern u64 lexer_cache_size;
+/* how many diagnostics are reported per file (--max-diagnostics), 0 for all */
+extern size_t lexer_max_diagnostics;
+#define LEXER_DEFAULT_MAX_DIAGNOSTICS 100
+
+/* Bumped whenever the lexer starts producing different tokens for the same
+ * input in a way `lexer_fingerprint` can't see.
+ */
+#define LEXER_VERSION "4"
+
 typedef struct {
       TokenType type;
 	TokenSubType subtype;
@@ -69,11 +130,107 @@ typedef struct {
 
 #define NULL_TOKEN ((Token) { FileEndToken, NOT_IDENTIFIER, strbuflit(NULL, 0, NULL) })
 
+/* All of the state needed to turn one source buffer into a token stream.
+ * Each context is independent of every other one, so separate threads can
+ * each lex their own buffer at the same time.
+ */
+typedef struct Lexer {
+	struct str_buf source;
+	char *filename; /* used for diagnostics */
+	char *token_start_pos;
+	bool stream_will_terminate;
+	bool is_escaped_char; /* the next byte is escaped by a backslash */
+	bool skipped_int_literal_prefix;
+	size_t n_dquotes,
+	       n_squotes;
+	char *str_start,
+	     *chr_start;
+	size_t chr_start_line; /* set if `chr_start` was dropped from a stream's chunk */
+	/* lines are looked up when a diagnostic needs one, rather than counted
+	 * while lexing: `lines` covers `source` once built, `line_base` is the
+	 * number of lines before it (in the chunks a stream has dropped)
+	 */
+	LineIndex lines;
+	size_t line_base;
+	size_t token_n;
+	size_t comment_bytes; /* skipped so far (LEXER_SKIP_COMMENTS) */
+	size_t in_char_for;
+	u32 errflags;
+	u32 options;
+	/* set if `source` is a chunk of a longer input (see lexer_stream.h):
+	 * tokens starting at or after `refill_at`, or running into the end of
+	 * the chunk, aren't lexed; `need_input` is set instead
+	 */
+	bool more_input;
+	bool need_input;
+	char *refill_at;
+	char *token_pos; /* where the last token started, after skipping whitespace and comments */
+	StructuralIndex sidx; /* covers the literal being lexed, if any */
+	LiteralPool literals; /* coalesced literals lexed so far */
+	DiagList diags; /* not reported yet (LEXER_DEFER_DIAGNOSTICS) */
+} Lexer;
+
 void print_usage_msg_lexer(void);
 void parse_args_lexer(s32 argc, char **argv);
 
+/* Allocates a lexer over `source`, which must stay alive (and NUL-terminated)
+ * for as long as the lexer and the tokens it returns are in use.
+ * `filename` is only used when printing diagnostics.
+ */
+Lexer *lexer_create(struct str_buf source, char *filename);
+/* Initializes a caller-owned lexer context, e.g. one on the stack. It
+ * starts from scratch, so a context that has lexed before must be passed to
+ * `lexer_cleanup` first or what it allocated leaks.
+ */
+void lexer_setup(Lexer *lx, struct str_buf source, char *filename);
+/* Returns the next token of `lx`'s stream, or `NULL_TOKEN` at the end of it. */
+Token lexer_next(Lexer *lx);
+/* Lexes up to `cap` tokens into `out` and returns how many were written;
+ * 0 means the end of the stream. A batch stops early after any token that
+ * set a new error flag, so that token is always the last one in `out`.
+ */
+size_t lexer_next_batch(Lexer *lx, Token *out, size_t cap);
+/* Looks up the escapes and decoded value of a String/CharLiteralToken
+ * returned by `lx`. The result stays valid until the next token is lexed.
+ */
+bool lexer_literal(const Lexer *lx, Token token, LiteralInfo *out);
+/* Makes `lx` allocate what it keeps (the tables of coalesced literals) from
+ * `arena` instead of with malloc. Must be called before lexing.
+ */
+void lexer_set_arena(Lexer *lx, Arena *arena);
+/* Returns the position of `pos`, a byte of `lx->source`, counting lines
+ * from the start of the whole input.
+ */
+SourcePos lexer_pos(Lexer *lx, const char *pos);
+/* Writes the diagnostics `lx` has kept since the last call to `stream`,
+ * sorted and without repeats, up to `lexer_max_diagnostics` for the whole
+ * input. `last` is for the final call, which notes any that were left out.
+ */
+void lexer_report(Lexer *lx, FILE *stream, bool last);
+/* Frees what a lexer context allocated, e.g. before it goes out of scope. */
+void lexer_cleanup(Lexer *lx);
+/* Frees a lexer returned by `lexer_create` (but not its source buffer). */
+void lexer_destroy(Lexer *lx);
+
+/* `lexer_init` and `next_token` operate on a single default context
+ * (named after SRC_PATH_L) and mirror its error flags into `errflags`.
+ * `lexer_init` can be called again for another source.
+ */
 void lexer_init(struct str_buf contents_in);
 bool is_null_token(Token token);
+/* Returns the keyword subtype of the identifier `ident`, or NORMAL_IDENTIFIER. */
+TokenSubType keyword_type(struct str_buf ident);
+/* Parses the value of the integer literal `token` into `*out`. Its text is
+ * the digits of its subtype's radix, which the lexer already checked, so
+ * this costs one `literal_parse_int`. Returns false for any other token and
+ * for literals that don't fit in 64 bits (INT_LITERAL_OVERFLOW).
+ */
+bool token_int_value(Token token, u64 *out);
+/* Identifies what the lexer makes of its input with `options`: its version,
+ * the tables generated from lexer_spec.h and the keyword set. Token streams
+ * cached with another fingerprint can't be reused.
+ */
+u64 lexer_fingerprint(u32 options);
 Token next_token(void);
 
 #endif /* LEXER_H */
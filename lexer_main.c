@@ -1,48 +1,633 @@
 #include "lexer.h"
+#include "lexer_stream.h"
+#include "job_pool.h"
+#include "lex_parallel.h"
+#include "token_cache.h"
+#include "token_file.h"
+#include "token_table.h"
+#include "token_writer.h"
 #include "preproc.h"
+#include "stats.h"
+#include "args.h"
 #include "util.h"
 
 #include <string.h>
 #include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
 
 extern char *SRC_PATH_L;
-extern u32 errflags;
 
-s32 main(s32 argc, char **argv)
+#define TOKEN_BATCH_SIZE 4096
+
+/* the cache given with --cache-dir, or NULL */
+static TokenCache *token_cache;
+
+/* Prints a batch of tokens from `lx` to `out`. Returns false if the last one
+ * was fatal; the caller then keeps lexing for the diagnostics, but prints no
+ * more batches.
+ */
+static bool print_batch(TokenWriter *out, Lexer *lx, Token *tokens, size_t n_tokens)
 {
-	parse_args_preproc(argc, argv, print_usage_msg_lexer, &SRC_PATH_L, NULL);
+	// a batch ends with the token that raised an error, so that one is never printed
+	bool fatal = lexer_geterr(lx, INT_LITERAL_HAS_NO_VALID_DIGITS);
+	if (fatal)
+		n_tokens--;
+	for (Token *cur_token = tokens; cur_token < tokens + n_tokens; ++cur_token)
+		token_writer_put(out, *cur_token);
+	return !fatal;
+}
 
-	struct str_buf src_contents = read_file_to_string(SRC_PATH_L);
-#ifdef STRIP_COMMENTS
-	struct str_buf file_contents = strip_comments(src_contents, SRC_PATH_L);
-	free(src_contents.buf);
+static u32 n_lex_threads(void)
+{
+	return (lexer_jobs != 0) ? lexer_jobs : job_pool_default_threads();
+}
+
+/* Lexes `src` both serially and in parallel and exits with 8 if the tokens
+ * differ.
+ */
+static void verify_parallel(struct str_buf src, char *path)
+{
+	TokenTable serial, parallel;
+	Lexer lx;
+	lexer_setup(&lx, src, path);
+	lx.options |= LEXER_QUIET;
+	token_table_init(&serial, src, path);
+	lexer_fill_table(&lx, &serial);
+	bool serial_ok = (lx.errflags == 0);
+	lexer_cleanup(&lx);
+
+	token_table_init(&parallel, src, path);
+	u32 n_threads = MAX(n_lex_threads(), 2);
+	LexParallelInfo info;
+	bool parallel_ok = lex_parallel(src, path, n_threads, &parallel, &info);
+	if (parallel_ok != serial_ok)
+	{
+		flogf(LOG_ERR, stderr, "parallel lexing of '%s' %s, serial lexing %s\n", path,
+				parallel_ok ? "succeeded" : "failed", serial_ok ? "succeeded" : "failed");
+		exit(8);
+	}
+	// with errors, lexing falls back to serial anyway
+	for (size_t i = 0; parallel_ok && i < MAX(serial.len, parallel.len); ++i)
+	{
+		if (i >= serial.len || i >= parallel.len || serial.offsets[i] != parallel.offsets[i]
+		 || serial.lengths[i] != parallel.lengths[i] || serial.kinds[i] != parallel.kinds[i])
+		{
+			flogf(LOG_ERR, stderr, "parallel lexing of '%s' differs from serial lexing at token #%zu"
+					" (of %zu serial, %zu parallel)\n", path, i, serial.len, parallel.len);
+			exit(8);
+		}
+	}
+	flogf(LOG_INFO, stderr, "parallel lexing of '%s' on %u threads matches serial lexing (%zu tokens,"
+			" %zu of %zu chunks speculated)\n", path, n_threads, serial.len,
+			info.n_speculated, info.n_chunks - 1);
+	token_table_free(&serial);
+	token_table_free(&parallel);
+}
+
+static void count_table_tokens(Stats *stats, const TokenTable *table)
+{
+	if (stats == NULL)
+		return;
+	for (size_t i = 0; i < table->len; ++i)
+	{
+		Token token = token_table_get(table, i);
+		stats_count_tokens(stats, &token, 1);
+	}
+}
+
+/* Lexes `src` on several threads and prints its tokens to `out`. Returns
+ * false, without printing anything, if it has errors to report.
+ */
+static bool lex_source_parallel(TokenWriter *out, struct str_buf src, char *path,
+		Stats *stats, StatsClock *clock)
+{
+	TokenTable table;
+	token_table_init(&table, src, path);
+	bool ok = lex_parallel(src, path, n_lex_threads(), &table, NULL);
+	stats_lap(stats, STATS_LEX, clock);
+	count_table_tokens(stats, &table);
+	for (size_t i = 0; i < table.len; ++i)
+		token_writer_put(out, token_table_get(&table, i));
+	token_table_free(&table);
+	stats_lap(stats, STATS_OUTPUT, clock);
+	return ok;
+}
+
+/* Writes `len` bytes of output kept for a file to `out`. */
+static void print_captured(FILE *out, const void *buf, size_t len, const char *path)
+{
+	if (fwrite(buf, 1, len, out) != len || fflush(out) != 0)
+	{
+		flogf(LOG_ERR, stderr, "failed to write tokens of '%s'\n", path);
+		exit(9);
+	}
+}
 
-	lexer_init(file_contents);
-#else
-	lexer_init(src_contents);
+/* Prints the cached output for `src` to `out`, if there is any, and sets
+ * `*status` to the exit code it was lexed with.
+ */
+static bool print_cached(TokenCache *cache, u64 key, const SourceFile *src, FILE *out,
+		s32 *status, Stats *stats, StatsClock *clock)
+{
+	TokenCacheEntry entry;
+	if (!token_cache_get(cache, key, src->contents, &entry))
+		return false;
+	print_captured(out, entry.data, entry.header->data_len, src->contents.container_filename);
+	*status = entry.header->status;
+	if (stats != NULL)
+	{
+		stats->n_files++;
+		stats->source_bytes += src->contents.len - 1;
+		stats->comment_bytes += entry.header->comment_bytes;
+	}
+	token_cache_release(&entry);
+	stats_lap(stats, STATS_OUTPUT, clock);
+	return true;
+}
+
+/* Lexes the file at `path` ("-" for stdin), printing its tokens to `out`.
+ * Everything it needs is allocated from `arena`, which is reset first.
+ * Returns the exit code for it: 0, 1 for a fatal token or 6 for an
+ * unterminated comment.
+ */
+static s32 lex_file(char *path, FILE *out, Arena *arena, Stats *stats)
+{
+#ifdef ARENA_DEBUG
+	size_t mallocs_before = arena_debug_mallocs();
 #endif
-	Token cur_token;
-	while (!is_null_token(cur_token = next_token()))
+	StatsClock clock = stats_clock();
+	arena_reset(arena);
+	// streamed input is lexed as it's read, so it can't be looked up first
+	bool streamed = (strcmp(path, "-") == 0 || (lexer_options & LEXER_STREAM_INPUT));
+	TokenCache *cache = streamed ? NULL : token_cache;
+	SourceFile src = {0};
+	u64 key = 0;
+	if (!streamed)
 	{
-		if (geterr(INT_LITERAL_HAS_NO_VALID_DIGITS))
+		src = load_source_file(path);
+		key = token_cache_hash(cache, src.contents);
+		stats_lap(stats, STATS_READ, &clock);
+		s32 status;
+		if (print_cached(cache, key, &src, out, &status, stats, &clock))
 		{
-			flogf(LOG_ERR, stderr, "error encountered; terminating token stream...\n");
-			exit(1);
+			unload_source_file(&src);
+			return status;
 		}
-		struct str_buf esc_str = dbg_escape_str(cur_token.value);
-		printf("{ type: 0x%02X, subtype: 0x%02X, value: \"%.*s\" }\n",
-			 cur_token.type,
-			 cur_token.subtype,
-			 (int)esc_str.len,
-			 esc_str.buf);
 	}
+	// with a cache, the output is kept to be stored once the file is lexed
+	char *captured = NULL;
+	size_t captured_len = 0;
+	FILE *dst = (cache != NULL) ? open_memstream(&captured, &captured_len) : out;
+	if (dst == NULL)
+	{
+		flogf(LOG_ERR, stderr, "failed to allocate output buffer for '%s'\n", path);
+		exit(3);
+	}
+	Token *tokens = arena_alloc(arena, TOKEN_BATCH_SIZE * sizeof(Token));
+	TokenWriter writer;
+	token_writer_open(&writer, dst, arena);
+	size_t n_tokens;
+	bool ok = true;
+	bool unterminated_comment;
+	bool cacheable = false;
+	u64 comment_bytes = 0;
+	if (streamed)
+	{
+		bool is_stdin = (strcmp(path, "-") == 0);
+		s32 fd = is_stdin ? STDIN_FILENO : open(path, O_RDONLY);
+		if (fd < 0)
+		{
+			flogf(LOG_ERR, stderr, "failed to open file '%s'\n", path);
+			exit(2);
+		}
+		LexerStream ls;
+		lexer_stream_open(&ls, fd, is_stdin ? "<stdin>" : path);
+		lexer_set_arena(&ls.lx, arena);
+		ls.lx.options |= LEXER_DEFER_DIAGNOSTICS;
+		// reading is part of lexing here
+		while ((n_tokens = lexer_stream_next_batch(&ls, tokens, TOKEN_BATCH_SIZE)) > 0)
+		{
+			stats_lap(stats, STATS_LEX, &clock);
+			stats_count_tokens(stats, tokens, n_tokens);
+			ok = ok && print_batch(&writer, &ls.lx, tokens, n_tokens);
+			stats_lap(stats, STATS_OUTPUT, &clock);
+		}
+		stats_lap(stats, STATS_LEX, &clock);
+		lexer_report(&ls.lx, stderr, true);
+		unterminated_comment = lexer_geterr(&ls.lx, UNTERMINATED_COMMENT);
+		if (stats != NULL)
+		{
+			stats->source_bytes += ls.n_read;
+			stats->comment_bytes += ls.lx.comment_bytes;
+		}
+		lexer_stream_close(&ls);
+		if (!is_stdin)
+			close(fd);
+	} else
+	{
+		if (lexer_options & LEXER_VERIFY_PARALLEL)
+		{
+			verify_parallel(src.contents, path);
+			clock = stats_clock();
+		}
+		// a single large file is split up instead (when there are multiple,
+		// the threads are already busy with one each)
+		bool lexed = false;
+		if (N_SRC_PATHS_L == 1 && src.contents.len >= LEX_PARALLEL_MIN_SIZE && n_lex_threads() > 1)
+			lexed = lex_source_parallel(&writer, src.contents, path, stats, &clock);
+		Lexer lx;
+		lexer_setup(&lx, src.contents, path);
+		lexer_set_arena(&lx, arena);
+		lx.options |= LEXER_DEFER_DIAGNOSTICS;
+		while (!lexed && (n_tokens = lexer_next_batch(&lx, tokens, TOKEN_BATCH_SIZE)) > 0)
+		{
+			stats_lap(stats, STATS_LEX, &clock);
+			stats_count_tokens(stats, tokens, n_tokens);
+			ok = ok && print_batch(&writer, &lx, tokens, n_tokens);
+			stats_lap(stats, STATS_OUTPUT, &clock);
+		}
+		stats_lap(stats, STATS_LEX, &clock);
+		lexer_report(&lx, stderr, true);
+		unterminated_comment = lexer_geterr(&lx, UNTERMINATED_COMMENT);
+		// output with diagnostics isn't cached, since they would be lost
+		cacheable = (lx.errflags == 0);
+		comment_bytes = lx.comment_bytes;
+		if (stats != NULL)
+		{
+			// the NUL isn't part of the file
+			stats->source_bytes += src.contents.len - 1;
+			stats->comment_bytes += lx.comment_bytes;
+		}
+		lexer_cleanup(&lx);
+	}
+	if (!token_writer_close(&writer))
+	{
+		flogf(LOG_ERR, stderr, "failed to write tokens of '%s'\n", path);
+		exit(9);
+	}
+	if (cache != NULL)
+	{
+		fclose(dst);
+		if (cacheable)
+			token_cache_put(cache, key, src.contents, 0, comment_bytes, captured, captured_len);
+		print_captured(out, captured, captured_len, path);
+		free(captured);
+	}
+	unload_source_file(&src);
+	if (!ok)
+		flogf(LOG_ERR, stderr, "error encountered; terminating token stream...\n");
+	stats_lap(stats, STATS_OUTPUT, &clock);
+	if (stats != NULL)
+		stats->n_files++;
 	freetmp();
+#ifdef ARENA_DEBUG
+	flogf(LOG_INFO, stderr, "'%s': %zu tokens, %zu malloc calls\n", path, writer.n_tokens,
+			arena_debug_mallocs() - mallocs_before);
+#endif
+	if (!ok)
+		return 1;
+	return unterminated_comment ? 6 : 0;
+}
+
+/* the output of one input file, kept until it's its turn to be printed */
+typedef struct {
+	char *out;
+	size_t out_len;
+	s32 status;
+} FileResult;
+
+typedef struct {
+	FileResult *results;
+	Arena *arenas; /* one per worker, reused for every file it lexes */
+	Stats *stats; /* one per worker, or NULL without --stats */
+} LexFilesCtx;
+
+/* Allocates a `Stats` for each worker, or returns NULL without --stats. */
+static Stats *worker_stats(void)
+{
+	if (!FLAG_SET(STATS))
+		return NULL;
+	Stats *stats = calloc(n_lex_threads(), sizeof(Stats));
+	if (stats == NULL)
+	{
+		flogf(LOG_ERR, stderr, "failed to allocate stats\n");
+		exit(3);
+	}
+	return stats;
+}
+
+/* Adds up and frees what `worker_stats` returned. */
+static void merge_worker_stats(Stats *total, Stats *stats)
+{
+	for (u32 i = 0; stats != NULL && i < n_lex_threads(); ++i)
+		stats_merge(total, &stats[i]);
+	free(stats);
+}
+
+static void lex_file_job(size_t job, u32 worker, void *ctx)
+{
+	LexFilesCtx *lf = ctx;
+	FileResult *result = &lf->results[job];
+	FILE *out = open_memstream(&result->out, &result->out_len);
+	if (out == NULL)
+	{
+		flogf(LOG_ERR, stderr, "failed to allocate output buffer for '%s'\n", SRC_PATHS_L[job]);
+		exit(3);
+	}
+	result->status = lex_file(SRC_PATHS_L[job], out, &lf->arenas[worker],
+			(lf->stats != NULL) ? &lf->stats[worker] : NULL);
+	fclose(out);
+}
+
+static size_t *size_order_sizes;
+
+static int cmp_larger_first(const void *a, const void *b)
+{
+	size_t size_a = size_order_sizes[*(const size_t *) a];
+	size_t size_b = size_order_sizes[*(const size_t *) b];
+	if (size_a != size_b)
+		return (size_a < size_b) ? 1 : -1;
+	return (*(const size_t *) a < *(const size_t *) b) ? -1 : 1;
+}
+
+/* Returns the indices of the input files, largest first. */
+static size_t *largest_first_order(void)
+{
+	size_t *order = malloc(N_SRC_PATHS_L * sizeof(size_t));
+	size_order_sizes = malloc(N_SRC_PATHS_L * sizeof(size_t));
+	if (order == NULL || size_order_sizes == NULL)
+	{
+		flogf(LOG_ERR, stderr, "failed to allocate the file list\n");
+		exit(3);
+	}
+	for (size_t i = 0; i < N_SRC_PATHS_L; ++i)
+	{
+		struct stat st;
+		order[i] = i;
+		size_order_sizes[i] = (stat(SRC_PATHS_L[i], &st) == 0) ? (size_t) st.st_size : 0;
+	}
+	qsort(order, N_SRC_PATHS_L, sizeof(size_t), cmp_larger_first);
+	free(size_order_sizes);
+	return order;
+}
+
+/* Lexes every input file on a thread pool, largest first, and prints their
+ * output in the order they were given. Returns the first nonzero exit code.
+ */
+static s32 lex_files_parallel(Stats *stats)
+{
+	FileResult *results = calloc(N_SRC_PATHS_L, sizeof(FileResult));
+	Arena *arenas = calloc(n_lex_threads(), sizeof(Arena));
+	if (results == NULL || arenas == NULL)
+	{
+		flogf(LOG_ERR, stderr, "failed to allocate the file list\n");
+		exit(3);
+	}
+	size_t *order = largest_first_order();
+
+	LexFilesCtx ctx = { results, arenas, worker_stats() };
+	JobPool pool;
+	job_pool_start(&pool, N_SRC_PATHS_L, order, n_lex_threads(), lex_file_job, &ctx);
+	s32 status = 0;
+	for (size_t i = 0; i < N_SRC_PATHS_L; ++i)
+	{
+		job_pool_wait(&pool, i);
+		StatsClock clock = stats_clock();
+		fwrite(results[i].out, 1, results[i].out_len, stdout);
+		free(results[i].out);
+		stats_lap(stats, STATS_OUTPUT, &clock);
+		if (status == 0)
+			status = results[i].status;
+	}
+	job_pool_finish(&pool);
+	merge_worker_stats(stats, ctx.stats);
+
+	for (u32 i = 0; i < n_lex_threads(); ++i)
+		arena_free(&arenas[i]);
+	free(arenas);
+	free(order);
+	free(results);
+	return status;
+}
+
+/* a file lexed into a token table, kept until the token file is written */
+typedef struct {
+	SourceFile src;
+	TokenTable tokens;
+	Arena arena; /* holds `tokens` and the literals lexed into it */
+	s32 status;
+} LexedFile;
+
+/* Fills `lexed->tokens` from the cache, if it has the tokens of `lexed->src`.
+ * An entry holds the table's offsets, lengths and kinds one after the other.
+ */
+static bool load_cached_table(u64 key, LexedFile *lexed, Stats *stats)
+{
+	TokenCacheEntry entry;
+	if (!token_cache_get(token_cache, key, lexed->src.contents, &entry))
+		return false;
+	size_t n_tokens = entry.header->data_len / (2 * sizeof(u32) + 1);
+	TokenTable cached = {
+		.offsets = (u32 *) entry.data,
+		.lengths = (u32 *) entry.data + n_tokens,
+		.kinds = (u8 *) entry.data + 2 * sizeof(u32) * n_tokens,
+		.len = n_tokens,
+	};
+	token_table_append(&lexed->tokens, &cached, 0, n_tokens, 0);
+	lexed->status = entry.header->status;
+	if (stats != NULL)
+		stats->comment_bytes += entry.header->comment_bytes;
+	count_table_tokens(stats, &lexed->tokens);
+	token_cache_release(&entry);
+	return true;
+}
+
+static void store_table(u64 key, LexedFile *lexed, u64 comment_bytes)
+{
+	if (token_cache == NULL)
+		return;
+	const TokenTable *table = &lexed->tokens;
+	size_t len = table->len * (2 * sizeof(u32) + 1);
+	u8 *data = malloc(MAX(len, 1));
+	if (data == NULL)
+	{
+		flogf(LOG_ERR, stderr, "failed to allocate a cache entry for '%s'\n",
+				table->source.container_filename);
+		exit(3);
+	}
+	memcpy(data, table->offsets, table->len * sizeof(u32));
+	memcpy(data + table->len * sizeof(u32), table->lengths, table->len * sizeof(u32));
+	memcpy(data + 2 * table->len * sizeof(u32), table->kinds, table->len);
+	token_cache_put(token_cache, key, lexed->src.contents, lexed->status, comment_bytes, data, len);
+	free(data);
+}
+
+/* Lexes the file at `path` ("-" for stdin) into `lexed`, keeping the tokens
+ * before the first fatal one like the text output does.
+ */
+static void lex_file_tokens(char *path, LexedFile *lexed, Stats *stats)
+{
+	StatsClock clock = stats_clock();
+	bool is_stdin = (strcmp(path, "-") == 0);
+	char *name = is_stdin ? "<stdin>" : path;
+	// token offsets need the whole input at once, so stdin isn't streamed
+	lexed->src = load_source_file(is_stdin ? "/dev/stdin" : path);
+	u64 key = token_cache_hash(token_cache, lexed->src.contents);
+	stats_lap(stats, STATS_READ, &clock);
+	if (stats != NULL)
+	{
+		stats->n_files++;
+		stats->source_bytes += lexed->src.contents.len - 1;
+	}
+	token_table_init(&lexed->tokens, lexed->src.contents, name);
+	lexed->tokens.arena = &lexed->arena;
+	if (load_cached_table(key, lexed, stats))
+	{
+		stats_lap(stats, STATS_READ, &clock);
+		return;
+	}
+	if (lexer_options & LEXER_VERIFY_PARALLEL)
+	{
+		verify_parallel(lexed->src.contents, name);
+		clock = stats_clock();
+	}
+	if (N_SRC_PATHS_L == 1 && lexed->src.contents.len >= LEX_PARALLEL_MIN_SIZE && n_lex_threads() > 1
+	 && lex_parallel(lexed->src.contents, name, n_lex_threads(), &lexed->tokens, NULL))
+	{
+		stats_lap(stats, STATS_LEX, &clock);
+		count_table_tokens(stats, &lexed->tokens);
+		lexed->status = 0;
+		store_table(key, lexed, 0);
+		return;
+	}
+
+	Lexer lx;
+	lexer_setup(&lx, lexed->src.contents, name);
+	lexer_set_arena(&lx, &lexed->arena);
+	lx.options |= LEXER_DEFER_DIAGNOSTICS;
+	Token batch[256];
+	size_t n;
+	bool fatal = false;
+	while ((n = lexer_next_batch(&lx, batch, sizeof(batch)/sizeof(*batch))) > 0)
+	{
+		stats_count_tokens(stats, batch, n);
+		// the rest is only lexed for its diagnostics
+		if (fatal)
+			continue;
+		// as in print_batch, a batch ends with the token that raised an error
+		fatal = lexer_geterr(&lx, INT_LITERAL_HAS_NO_VALID_DIGITS);
+		for (size_t i = 0; i < n - fatal; ++i)
+			token_table_push(&lexed->tokens, batch[i]);
+	}
+	stats_lap(stats, STATS_LEX, &clock);
+	if (stats != NULL)
+		stats->comment_bytes += lx.comment_bytes;
+	lexer_report(&lx, stderr, true);
+	if (fatal)
+		flogf(LOG_ERR, stderr, "error encountered; terminating token stream...\n");
+	lexed->status = fatal ? 1 : lexer_geterr(&lx, UNTERMINATED_COMMENT) ? 6 : 0;
+	// as in lex_file, only tokens lexed without diagnostics are cached
+	if (lx.errflags == 0)
+		store_table(key, lexed, lx.comment_bytes);
+	lexer_cleanup(&lx);
+	freetmp();
+}
+
+typedef struct {
+	LexedFile *lexed;
+	Stats *stats; /* one per worker, or NULL without --stats */
+} LexTokensCtx;
+
+static void lex_file_tokens_job(size_t job, u32 worker, void *ctx)
+{
+	LexTokensCtx *lt = ctx;
+	lex_file_tokens(SRC_PATHS_L[job], &lt->lexed[job], (lt->stats != NULL) ? &lt->stats[worker] : NULL);
+}
+
+/* Lexes every input file (on a thread pool if there are several) and writes
+ * them all to stdout as one token file. Returns the first nonzero exit code.
+ */
+static s32 write_token_file(Stats *stats)
+{
+	LexedFile *lexed = calloc(N_SRC_PATHS_L, sizeof(LexedFile));
+	TokenFileInput *inputs = calloc(N_SRC_PATHS_L, sizeof(TokenFileInput));
+	if (lexed == NULL || inputs == NULL)
+	{
+		flogf(LOG_ERR, stderr, "failed to allocate the file list\n");
+		exit(3);
+	}
+	size_t *order = largest_first_order();
+	LexTokensCtx ctx = { lexed, worker_stats() };
+	JobPool pool;
+	job_pool_start(&pool, N_SRC_PATHS_L, order, (N_SRC_PATHS_L > 1) ? n_lex_threads() : 1,
+			lex_file_tokens_job, &ctx);
+	job_pool_finish(&pool);
+	merge_worker_stats(stats, ctx.stats);
+
+	s32 status = 0;
+	for (size_t i = 0; i < N_SRC_PATHS_L; ++i)
+	{
+		inputs[i] = (TokenFileInput) {
+			lexed[i].tokens.source.container_filename, &lexed[i].tokens, lexed[i].status
+		};
+		if (status == 0)
+			status = lexed[i].status;
+	}
+	StatsClock clock = stats_clock();
+	if (!token_file_write(stdout, inputs, N_SRC_PATHS_L, (lexer_options & LEXER_EMBED_SOURCE) != 0))
+	{
+		flogf(LOG_ERR, stderr, "failed to write token file\n");
+		exit(9);
+	}
+	stats_lap(stats, STATS_OUTPUT, &clock);
+
+	for (size_t i = 0; i < N_SRC_PATHS_L; ++i)
+	{
+		arena_free(&lexed[i].arena);
+		unload_source_file(&lexed[i].src);
+	}
+	free(order);
+	free(inputs);
+	free(lexed);
+	return status;
+}
+
+s32 main(s32 argc, char **argv)
+{
+	StatsClock start = stats_clock();
+	parse_args_lexer(argc, argv);
 
 #ifdef STRIP_COMMENTS
-	free(file_contents.buf);
-#else
-	free(src_contents.buf);
+	// comments are skipped while lexing instead of in a separate pass
+	lexer_options |= LEXER_SKIP_COMMENTS;
 #endif
-
-	return 0;
+	Stats all_stats = {0};
+	Stats *stats = FLAG_SET(STATS) ? &all_stats : NULL;
+	TokenCache cache;
+	if (lexer_cache_dir != NULL)
+	{
+		// the two formats cache different things for the same file
+		const char *format = (lexer_options & LEXER_BINARY_OUTPUT) ? "bin" : "text";
+		u64 fingerprint = hash_bytes(format, strlen(format), lexer_fingerprint(lexer_options));
+		if (token_cache_open(&cache, lexer_cache_dir, lexer_cache_size, fingerprint))
+			token_cache = &cache;
+	}
+	s32 status;
+	if (lexer_options & LEXER_BINARY_OUTPUT)
+		status = write_token_file(stats);
+	else if (N_SRC_PATHS_L > 1)
+		status = lex_files_parallel(stats);
+	else
+	{
+		Arena arena = {0};
+		status = lex_file(SRC_PATH_L, stdout, &arena, stats);
+		arena_free(&arena);
+	}
+	token_cache_close(token_cache);
+	stats_print(stderr, stats, start);
+	if (lexer_options & LEXER_CACHE_STATS)
+		token_cache_print_stats(stderr, token_cache);
+	return status;
 }
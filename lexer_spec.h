@@ -0,0 +1,81 @@
+#ifndef LEXER_SPEC_H
+#define LEXER_SPEC_H
+
+/* The token grammar outside of string and character literals.
+ * gen_lexer_tables.c compiles these lists into lexer_tables.h at build time:
+ * a 256-entry character class table that picks how a token starting with a
+ * given byte is lexed, and a transition table that resolves operators and
+ * punctuation by maximal munch. Only byte values are used here, so this file
+ * is also included by lexer.c for the class names.
+ */
+
+/* character classes, i.e. what the first byte of a token means */
+enum {
+	CC_OTHER = 0, /* lexed as a 1-byte MiscToken */
+	CC_END,       /* '\0' */
+	CC_SPACE,     /* skipped before a token */
+	CC_IDENT,     /* starts an identifier or keyword */
+	CC_DIGIT,     /* starts an integer literal (maybe with a 0d/0x/0o/0b prefix) */
+	CC_QUOTE,     /* starts or ends a string/char literal */
+	CC_OPERATOR,  /* starts an operator or punctuation, see LEXER_OPERATORS */
+};
+
+/* X(class, first byte, last byte) */
+#define LEXER_CHAR_CLASSES(X) \
+	X(CC_END, '\0', '\0') \
+	X(CC_SPACE, '\t', '\r') \
+	X(CC_SPACE, ' ', ' ') \
+	X(CC_IDENT, 'a', 'z') \
+	X(CC_IDENT, 'A', 'Z') \
+	X(CC_IDENT, '_', '_') \
+	X(CC_DIGIT, '0', '9') \
+	X(CC_QUOTE, '"', '"') \
+	X(CC_QUOTE, '\'', '\'')
+
+/* X(lexeme, type, subtype). Every byte that starts a lexeme gets CC_OPERATOR. */
+#define LEXER_OPERATORS(X) \
+	X("...", VariableArgumentIndicatorToken, NOT_IDENTIFIER) \
+	X("->", ReturnTypeIndicatorToken, NOT_IDENTIFIER) \
+	X(":=", VarTypeInferInitToken, NOT_IDENTIFIER) \
+	X("==", OperatorToken, NOT_IDENTIFIER) \
+	X("!=", OperatorToken, NOT_IDENTIFIER) \
+	X("<=", OperatorToken, NOT_IDENTIFIER) \
+	X(">=", OperatorToken, NOT_IDENTIFIER) \
+	X("+=", OperatorToken, NOT_IDENTIFIER) \
+	X("-=", OperatorToken, NOT_IDENTIFIER) \
+	X("*=", OperatorToken, NOT_IDENTIFIER) \
+	X("/=", OperatorToken, NOT_IDENTIFIER) \
+	X("%=", OperatorToken, NOT_IDENTIFIER) \
+	X("&=", OperatorToken, NOT_IDENTIFIER) \
+	X("|=", OperatorToken, NOT_IDENTIFIER) \
+	X("^=", OperatorToken, NOT_IDENTIFIER) \
+	X("~=", OperatorToken, NOT_IDENTIFIER) \
+	X("<<", OperatorToken, NOT_IDENTIFIER) \
+	X(">>", OperatorToken, NOT_IDENTIFIER) \
+	X("{", StartBlockToken, GROUPING_TOKEN) \
+	X("}", EndBlockToken, GROUPING_TOKEN) \
+	X("[", StartBracketToken, GROUPING_TOKEN) \
+	X("]", EndBracketToken, GROUPING_TOKEN) \
+	X("(", StartParenToken, GROUPING_TOKEN) \
+	X(")", EndParenToken, GROUPING_TOKEN) \
+	X(",", ItemSeparatorToken, NOT_IDENTIFIER) \
+	X(";", EndStatementToken, NOT_IDENTIFIER) \
+	X("=", OperatorToken, NOT_IDENTIFIER) \
+	X("!", OperatorToken, NOT_IDENTIFIER) \
+	X("<", OperatorToken, NOT_IDENTIFIER) \
+	X(">", OperatorToken, NOT_IDENTIFIER) \
+	X("+", OperatorToken, NOT_IDENTIFIER) \
+	X("-", OperatorToken, NOT_IDENTIFIER) \
+	X("*", OperatorToken, NOT_IDENTIFIER) \
+	X("/", OperatorToken, NOT_IDENTIFIER) \
+	X("%", OperatorToken, NOT_IDENTIFIER) \
+	X("@", OperatorToken, NOT_IDENTIFIER) \
+	X("&", OperatorToken, NOT_IDENTIFIER) \
+	X("|", OperatorToken, NOT_IDENTIFIER) \
+	X("^", OperatorToken, NOT_IDENTIFIER) \
+	X("~", OperatorToken, NOT_IDENTIFIER) \
+	X(":", OperatorToken, NOT_IDENTIFIER) \
+	X("?", OperatorToken, NOT_IDENTIFIER) \
+	X(".", OperatorToken, NOT_IDENTIFIER)
+
+#endif /* LEXER_SPEC_H */
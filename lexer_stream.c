@@ -0,0 +1,115 @@
+#include "lexer_stream.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "lexer.h"
+#include "line_index.h"
+#include "literal.h"
+#include "scan.h"
+#include "types.h"
+#include "util.h"
+
+static void stream_grow(LexerStream *ls, size_t capacity)
+{
+	char *new_buf = realloc(ls->buf, capacity + 1 + SOURCE_PADDING);
+	if (new_buf == NULL)
+	{
+		flogf(LOG_ERR, stderr, "failed to reallocate stream buffer with size %zu\n",
+				capacity + 1 + SOURCE_PADDING);
+		exit(4);
+	}
+	ls->buf = new_buf;
+	ls->capacity = capacity;
+}
+
+/* Moves a pointer into the old chunk to where its byte is after dropping the
+ * first `dropped` bytes, or to the start of the chunk if it was dropped.
+ */
+static char *rebase(char *p, char *old_buf, size_t dropped, char *new_buf)
+{
+	if (p == NULL)
+		return NULL;
+	size_t off = p - old_buf;
+	return new_buf + ((off > dropped) ? off - dropped : 0);
+}
+
+/* Drops everything before the next token and reads another chunk. */
+static void stream_refill(LexerStream *ls)
+{
+	Lexer *lx = &ls->lx;
+	char *old_buf = ls->buf;
+	size_t dropped = lx->token_start_pos - ls->buf;
+	// deferred diagnostics point into the chunk, so they can't outlive it
+	lexer_report(lx, stderr, false);
+	// lines are still counted from the start of the input, and a dropped
+	// literal start keeps its line
+	if (lx->chr_start != NULL && lx->chr_start < ls->buf + dropped && lx->chr_start_line == 0)
+		lx->chr_start_line = lexer_pos(lx, lx->chr_start).line;
+	size_t n_newlines;
+	scan_newlines(ls->buf, ls->buf + dropped, NULL, &n_newlines);
+	lx->line_base += n_newlines;
+	line_index_free(&lx->lines);
+	memmove(ls->buf, ls->buf + dropped, ls->len - dropped);
+	ls->len -= dropped;
+	if (ls->capacity - ls->len < LEXER_STREAM_CHUNK)
+		stream_grow(ls, MAX(ls->capacity * 2, ls->len + LEXER_STREAM_CHUNK));
+
+	ssize_t n_read;
+	do
+		n_read = read(ls->fd, ls->buf + ls->len, LEXER_STREAM_CHUNK);
+	while (n_read < 0 && errno == EINTR);
+	if (n_read < 0)
+	{
+		flogf(LOG_ERR, stderr, "failed to read '%s': %s\n", lx->filename, strerror(errno));
+		exit(5);
+	}
+	ls->len += n_read;
+	ls->n_read += n_read;
+	ls->eof = (n_read == 0);
+	memset(ls->buf + ls->len, '\0', 1 + SOURCE_PADDING);
+
+	// point the lexer at the new chunk; tokens from the old one are gone, and
+	// so are their literal records
+	lx->str_start = rebase(lx->str_start, old_buf, dropped, ls->buf);
+	lx->chr_start = rebase(lx->chr_start, old_buf, dropped, ls->buf);
+	lx->source = strbuflit(ls->buf, ls->len, lx->filename);
+	lx->token_start_pos = ls->buf;
+	lx->stream_will_terminate = false;
+	lx->more_input = !ls->eof;
+	lx->need_input = false;
+	lx->refill_at = ls->buf + ((ls->len > LEXER_STREAM_LOOKAHEAD) ? ls->len - LEXER_STREAM_LOOKAHEAD : 0);
+	lx->sidx.window_start = lx->sidx.window_end = NULL;
+	literal_pool_clear(&lx->literals);
+}
+
+void lexer_stream_open(LexerStream *ls, s32 fd, char *filename)
+{
+	*ls = (LexerStream) {0};
+	ls->fd = fd;
+	stream_grow(ls, 2 * LEXER_STREAM_CHUNK);
+	ls->buf[0] = '\0';
+	lexer_setup(&ls->lx, strbuflit(ls->buf, 0, filename), filename);
+	ls->lx.more_input = true;
+	ls->lx.refill_at = ls->buf;
+}
+
+size_t lexer_stream_next_batch(LexerStream *ls, Token *out, size_t cap)
+{
+	for (;;)
+	{
+		size_t n = lexer_next_batch(&ls->lx, out, cap);
+		if (n > 0 || !ls->lx.need_input)
+			return n;
+		stream_refill(ls);
+	}
+}
+
+void lexer_stream_close(LexerStream *ls)
+{
+	lexer_cleanup(&ls->lx);
+	free(ls->buf);
+	*ls = (LexerStream) {0};
+}
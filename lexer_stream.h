@@ -0,0 +1,43 @@
+#ifndef LEXER_STREAM_H
+#define LEXER_STREAM_H
+
+#include <stddef.h>
+
+#include "lexer.h"
+#include "types.h"
+
+/* Lexes an input read from a file descriptor (e.g. stdin or a pipe) in
+ * chunks, so memory use doesn't depend on the size of the input. Only the
+ * unlexed tail of the last chunk is kept when the next one is read, so the
+ * buffer only grows past `LEXER_STREAM_CHUNK` for a single token that is
+ * longer than that (e.g. a coalesced literal or a comment).
+ */
+
+#ifndef LEXER_STREAM_CHUNK
+#define LEXER_STREAM_CHUNK (64 << 10)
+#endif
+/* tokens are only lexed if at least this many bytes of the chunk follow
+ * their start, which covers all lookahead except runs that can go on
+ * indefinitely (those are lexed again once more input is read)
+ */
+#define LEXER_STREAM_LOOKAHEAD 64
+
+typedef struct {
+	Lexer lx;
+	s32 fd;
+	char *buf;
+	size_t len; /* bytes of input in `buf` */
+	size_t capacity; /* not counting the NUL and padding after the input */
+	u64 n_read; /* bytes read from `fd` so far */
+	bool eof;
+} LexerStream;
+
+/* Starts lexing `fd`, which is left open. `filename` is used for diagnostics. */
+void lexer_stream_open(LexerStream *ls, s32 fd, char *filename);
+/* Like `lexer_next_batch`, but reads more input as needed. The tokens stay
+ * valid until the next call, which may replace the chunk they point into.
+ */
+size_t lexer_stream_next_batch(LexerStream *ls, Token *out, size_t cap);
+void lexer_stream_close(LexerStream *ls);
+
+#endif /* LEXER_STREAM_H */
@@ -0,0 +1,68 @@
+#include "line_index.h"
+
+#include <stdlib.h>
+
+#include "scan.h"
+#include "types.h"
+#include "util.h"
+
+void line_index_build(LineIndex *idx, char *buf, size_t len)
+{
+	size_t n_newlines;
+	char *text_end = scan_newlines(buf, buf + len, NULL, &n_newlines);
+	idx->starts = malloc((n_newlines + 1) * sizeof(size_t));
+	if (idx->starts == NULL)
+	{
+		flogf(LOG_ERR, stderr, "failed to allocate a line index of %zu lines\n", n_newlines + 1);
+		exit(3);
+	}
+	// each line starts after the previous one's newline
+	idx->starts[0] = 0;
+	scan_newlines(buf, text_end, idx->starts + 1, &n_newlines);
+	for (size_t i = 1; i <= n_newlines; ++i)
+		idx->starts[i]++;
+	idx->n_lines = n_newlines + 1;
+	idx->len = text_end - buf;
+}
+
+void line_index_free(LineIndex *idx)
+{
+	free(idx->starts);
+	*idx = (LineIndex) {0};
+}
+
+size_t line_index_find(const LineIndex *idx, size_t offset)
+{
+	// the last line starting at or before `offset`
+	size_t lo = 0, hi = idx->n_lines;
+	while (hi - lo > 1)
+	{
+		size_t mid = lo + (hi - lo) / 2;
+		if (idx->starts[mid] <= offset)
+			lo = mid;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+size_t line_index_start(const LineIndex *idx, size_t line)
+{
+	return idx->starts[line];
+}
+
+size_t line_index_end(const LineIndex *idx, size_t line)
+{
+	return (line + 1 < idx->n_lines) ? idx->starts[line + 1] - 1 : idx->len;
+}
+
+SourcePos line_index_pos(const LineIndex *idx, const char *buf, size_t offset)
+{
+	size_t line = line_index_find(idx, offset);
+	size_t start = line_index_start(idx, line);
+	return (SourcePos) {
+		.line = line + 1,
+		.col = offset - start + 1,
+		.display_col = display_width(buf + start, buf + offset, 0) + 1,
+	};
+}
@@ -0,0 +1,36 @@
+#ifndef LINE_INDEX_H
+#define LINE_INDEX_H
+
+#include <stddef.h>
+
+#include "types.h"
+#include "util.h"
+
+/* The offset of the start of every line of a source, so that any offset
+ * maps to its line and column by a binary search instead of a scan. Built
+ * with one vectorized pass to count the newlines and one to record them.
+ * The text ends at its first '\0', like it does for the lexer.
+ */
+typedef struct {
+	size_t *starts; /* starts[0] == 0, one per line */
+	size_t n_lines;
+	size_t len; /* of the text, up to the first '\0' */
+} LineIndex;
+
+/* a position in a source, all 1-based */
+typedef struct {
+	size_t line;
+	size_t col; /* in bytes */
+	size_t display_col; /* with tabs expanded to the next multiple of `tab_width` */
+} SourcePos;
+
+void line_index_build(LineIndex *idx, char *buf, size_t len);
+void line_index_free(LineIndex *idx);
+/* Returns the 0-based line containing `offset` (or the last line, past the end). */
+size_t line_index_find(const LineIndex *idx, size_t offset);
+/* the offsets of the first byte of `line` (0-based) and of its '\n' or the end */
+size_t line_index_start(const LineIndex *idx, size_t line);
+size_t line_index_end(const LineIndex *idx, size_t line);
+SourcePos line_index_pos(const LineIndex *idx, const char *buf, size_t offset);
+
+#endif /* LINE_INDEX_H */
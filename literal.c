@@ -0,0 +1,198 @@
+#include "literal.h"
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "arena.h"
+#include "types.h"
+#include "util.h"
+
+static void *pool_reserve(LiteralPool *pool, void *buf, size_t *cap, size_t need, size_t elem_size)
+{
+	if (need <= *cap)
+		return buf;
+	size_t new_cap = MAX(MAX(*cap * 2, need), 64);
+	if (pool->arena != NULL)
+	{
+		buf = arena_realloc(pool->arena, buf, *cap * elem_size, new_cap * elem_size);
+		*cap = new_cap;
+		return buf;
+	}
+	void *new_buf = realloc(buf, new_cap * elem_size);
+	if (new_buf == NULL)
+	{
+		flogf(LOG_ERR, stderr, "failed to reallocate literal pool with size %zu\n", new_cap * elem_size);
+		exit(4);
+	}
+	*cap = new_cap;
+	return new_buf;
+}
+
+static u8 hex_value(char c)
+{
+	return isdigit(c) ? c - '0' : (tolower(c) - 'a' + 10);
+}
+
+size_t literal_decode_escape(const char *esc, const char *end, char *out)
+{
+	if (esc + 1 >= end)
+	{
+		*out = '\\';
+		return 1;
+	}
+	switch (esc[1]) {
+	case 'n': *out = '\n'; return 2;
+	case 't': *out = '\t'; return 2;
+	case 'r': *out = '\r'; return 2;
+	case '0': *out = '\0'; return 2;
+	case 'x':
+		if (esc + 3 < end && isxdigit(esc[2]) && isxdigit(esc[3]))
+		{
+			*out = (char) (hex_value(esc[2]) << 4 | hex_value(esc[3]));
+			return 4;
+		}
+		*out = 'x';
+		return 2;
+	default: // \\, \", \' and anything unknown stand for themselves
+		*out = esc[1];
+		return 2;
+	}
+}
+
+static const u64 radix_base[] = {
+	[DIGITS_DEC] = 10,
+	[DIGITS_HEX] = 16,
+	[DIGITS_OCT] = 8,
+	[DIGITS_BIN] = 2,
+};
+
+/* the value of one digit, any of [0-9A-Fa-f] */
+static u8 digit_value(char c)
+{
+	return (c & 0x0F) + ((c & 0x40) >> 6) * 9;
+}
+
+/* Returns the value of the 8 digits at `p`. Every byte is turned into its
+ * digit at once, then neighbouring digits, pairs and quads are combined
+ * with one multiply each (the first digit is the lowest byte and the most
+ * significant, so big-endian loads are swapped first).
+ */
+static u64 digits8_value(const char *p, u64 base)
+{
+	u64 v;
+	memcpy(&v, p, 8);
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+	v = __builtin_bswap64(v);
+#endif
+	v = (v & 0x0F0F0F0F0F0F0F0FULL) + ((v & 0x4040404040404040ULL) >> 6) * 9;
+	v = (v * base + (v >> 8)) & 0x00FF00FF00FF00FFULL;
+	v = (v * (base * base) + (v >> 16)) & 0x0000FFFF0000FFFFULL;
+	return (v * (base * base * base * base) + (v >> 32)) & 0xFFFFFFFFULL;
+}
+
+bool literal_parse_int(const char *digits, size_t len, DigitRadix radix, u64 *out)
+{
+	u64 base = radix_base[radix];
+	u64 base8 = base * base * base * base * base * base * base * base;
+	const char *p = digits, *end = digits + len;
+	// leading zeros don't count towards overflowing
+	while (p < end && *p == '0')
+		p++;
+	u64 value = 0;
+	bool overflow = false;
+	for (; end - p >= 8 && !overflow; p += 8)
+		overflow = __builtin_mul_overflow(value, base8, &value)
+		        || __builtin_add_overflow(value, digits8_value(p, base), &value);
+	for (; p < end && !overflow; ++p)
+		overflow = __builtin_mul_overflow(value, base, &value)
+		        || __builtin_add_overflow(value, digit_value(*p), &value);
+	*out = value;
+	return !overflow;
+}
+
+void literal_pool_push_escape(LiteralPool *pool, u32 offset)
+{
+	pool->escapes = pool_reserve(pool, pool->escapes, &pool->escapes_cap,
+			pool->n_escapes + 1, sizeof(u32));
+	pool->escapes[pool->n_escapes++] = offset;
+}
+
+size_t literal_pool_add(LiteralPool *pool, struct str_buf body, size_t offset)
+{
+	size_t escapes_start = (pool->n_records > 0)
+		? pool->records[pool->n_records-1].escapes_start + pool->records[pool->n_records-1].n_escapes
+		: 0;
+	pool->records = pool_reserve(pool, pool->records, &pool->records_cap,
+			pool->n_records + 1, sizeof(LiteralRecord));
+	LiteralRecord *rec = &pool->records[pool->n_records++];
+	rec->offset = offset;
+	rec->escapes_start = escapes_start;
+	rec->n_escapes = pool->n_escapes - escapes_start;
+	rec->decoded_start = pool->n_bytes;
+	rec->decoded_len = body.len;
+	// fast path: the body is its own decoded value
+	if (rec->n_escapes == 0)
+		return body.len;
+	const u32 *escapes = pool->escapes + escapes_start;
+
+	// decoding never makes the body longer
+	pool->bytes = pool_reserve(pool, pool->bytes, &pool->bytes_cap, pool->n_bytes + body.len, 1);
+	char *out = pool->bytes + pool->n_bytes;
+	const char *src = body.buf, *end = body.buf + body.len;
+	for (size_t i = 0; i < rec->n_escapes; ++i)
+	{
+		const char *esc = body.buf + escapes[i];
+		memcpy(out, src, esc - src);
+		out += esc - src;
+		src = esc + literal_decode_escape(esc, end, out++);
+	}
+	memcpy(out, src, end - src);
+	out += end - src;
+
+	rec->decoded_len = out - (pool->bytes + pool->n_bytes);
+	pool->n_bytes += rec->decoded_len;
+	return rec->decoded_len;
+}
+
+bool literal_pool_find(const LiteralPool *pool, struct str_buf body, size_t offset, LiteralInfo *out)
+{
+	// records are added in source order
+	size_t lo = 0, hi = pool->n_records;
+	while (lo < hi)
+	{
+		size_t mid = lo + (hi - lo) / 2;
+		if (pool->records[mid].offset < offset)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	if (lo == pool->n_records || pool->records[lo].offset != offset)
+		return false;
+
+	const LiteralRecord *rec = &pool->records[lo];
+	out->escapes = pool->escapes + rec->escapes_start;
+	out->n_escapes = rec->n_escapes;
+	out->decoded = (rec->n_escapes == 0)
+		? body
+		: strbuflit(pool->bytes + rec->decoded_start, rec->decoded_len, body.container_filename);
+	return true;
+}
+
+void literal_pool_clear(LiteralPool *pool)
+{
+	pool->n_records = pool->n_escapes = pool->n_bytes = 0;
+}
+
+void literal_pool_free(LiteralPool *pool)
+{
+	Arena *arena = pool->arena;
+	if (arena == NULL)
+	{
+		free(pool->records);
+		free(pool->escapes);
+		free(pool->bytes);
+	}
+	*pool = (LiteralPool) { .arena = arena };
+}
@@ -0,0 +1,69 @@
+#ifndef LITERAL_H
+#define LITERAL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "arena.h"
+#include "scan.h"
+#include "types.h"
+#include "util.h"
+
+/* Side tables for literal tokens, owned by a lexer. For every coalesced
+ * string/char literal it keeps the offsets of its escape sequences and, if
+ * it has any, the decoded value; literals without escapes decode to their
+ * own source text, so nothing is copied for them.
+ */
+
+typedef struct {
+	size_t offset; /* of the literal's body in the source, for lookups */
+	size_t escapes_start, n_escapes; /* into LiteralPool.escapes */
+	size_t decoded_start, decoded_len; /* into LiteralPool.bytes, if n_escapes > 0 */
+} LiteralRecord;
+
+typedef struct {
+	LiteralRecord *records;
+	size_t n_records, records_cap;
+	u32 *escapes;
+	size_t n_escapes, escapes_cap; /* including the pending ones */
+	char *bytes;
+	size_t n_bytes, bytes_cap;
+	Arena *arena; /* where the tables are allocated, or NULL for malloc */
+} LiteralPool;
+
+/* What a caller gets back for one literal. Pointers stay valid until the
+ * next literal is added to the pool.
+ */
+typedef struct {
+	const u32 *escapes; /* offset of each escape's backslash, relative to the body */
+	size_t n_escapes;
+	struct str_buf decoded;
+} LiteralInfo;
+
+/* Adds the offset (relative to its body) of an escape backslash in the
+ * literal that is about to be added.
+ */
+void literal_pool_push_escape(LiteralPool *pool, u32 offset);
+/* Records the literal whose body `body` starts `offset` bytes into the
+ * source, with the escapes pushed since the last one. Returns the decoded
+ * length.
+ */
+size_t literal_pool_add(LiteralPool *pool, struct str_buf body, size_t offset);
+/* Looks up the literal whose body starts `offset` bytes into the source.
+ * Returns false if there isn't one.
+ */
+bool literal_pool_find(const LiteralPool *pool, struct str_buf body, size_t offset, LiteralInfo *out);
+/* Forgets every literal but keeps the memory for reuse. */
+void literal_pool_clear(LiteralPool *pool);
+void literal_pool_free(LiteralPool *pool);
+
+/* Decodes one escape sequence starting at the backslash `esc` (< `end`) into
+ * `*out` and returns its length in the source.
+ */
+size_t literal_decode_escape(const char *esc, const char *end, char *out);
+/* Parses the `len` digits of `radix` at `digits` (without a prefix) into
+ * `*out`, eight at a time. Returns false if the value doesn't fit in 64 bits.
+ */
+bool literal_parse_int(const char *digits, size_t len, DigitRadix radix, u64 *out);
+
+#endif /* LITERAL_H */
@@ -4,6 +4,7 @@
 #include <string.h>
 #include <stdio.h>
 
+#include "arena.h"
 #include "types.h"
 #include "util.h"
 #include "args.h"
@@ -21,6 +22,7 @@ void print_usage_msg_preproc(void)
 		   "  --tab-width=N     sets tab display width to N cells (no effect with --no-color for reasons)\n"
 		   "  -h, --help        show this help message\n"
 		   "  -d, --debug       enable debug output\n"
+		   "  --stats           print timings and counts at the end\n"
 		   "  --no-color        print output without color\n"
 		   "  --info            print program info\n"
 			, PROG_NAME);
@@ -45,6 +47,8 @@ void parse_args_preproc(s32 argc, char **argv, void (*usage_msg) (void),
 					print_info();
 				else if (strcmp(argv[arg_n]+2, "debug") == 0)
 					SET_FLAG(DEBUG);
+				else if (strcmp(argv[arg_n]+2, "stats") == 0)
+					SET_FLAG(STATS);
 				else
 					flogf(LOG_ERR, stderr, "Unknown option '%s'\n", argv[arg_n]);
 			} else {
@@ -81,14 +85,14 @@ void parse_args_preproc(s32 argc, char **argv, void (*usage_msg) (void),
 		(*usage_msg)();
 }
 
-struct str_buf strip_comments(struct str_buf in_buf, char *container_filename)
+struct str_buf strip_comments(struct str_buf in_buf, char *container_filename, Arena *arena)
 {
 	struct str_buf out_file = {0};
-	out_file.buf = calloc(in_buf.len, 1);
+	out_file.buf = arena_calloc(arena, in_buf.len);
 	out_file.len = 0;
 
 	bool in_short_comment = false;
-	bool in_comment;
+	bool in_comment = false;
 
 	char *cur_comment_start = NULL;
 	size_t cur_comment_start_line_n = 0;
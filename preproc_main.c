@@ -1,21 +1,38 @@
 #include <string.h>
 
 #include "types.h"
+#include "args.h"
 #include "preproc.h"
+#include "stats.h"
 
 extern char *SRC_PATH_P, *DST_PATH_P;
 
 
 s32 main(s32 argc, char **argv)
 {
+	StatsClock start = stats_clock();
 	parse_args_preproc(argc, argv, print_usage_msg_preproc, &SRC_PATH_P, &DST_PATH_P);
+	Stats all_stats = {0};
+	Stats *stats = FLAG_SET(STATS) ? &all_stats : NULL;
+	StatsClock clock = stats_clock();
 
+	Arena arena = {0};
 	struct str_buf in_buf = read_file_to_string(SRC_PATH_P);
-	struct str_buf out_buf = strip_comments(in_buf, SRC_PATH_P);
+	stats_lap(stats, STATS_READ, &clock);
+	struct str_buf out_buf = strip_comments(in_buf, SRC_PATH_P, &arena);
+	stats_lap(stats, STATS_STRIP, &clock);
+	if (stats != NULL)
+	{
+		stats->n_files = 1;
+		// the NUL isn't part of the file (nor counted in `out_buf`)
+		stats->source_bytes = in_buf.len - 1;
+		stats->comment_bytes = stats->source_bytes - out_buf.len;
+	}
 	free(in_buf.buf);
 
 	if (DST_PATH_P && strcmp(DST_PATH_P, "nope") == 0) {
-		free(out_buf.buf);
+		arena_free(&arena);
+		stats_print(stderr, stats, start);
 		return 0;
 	}
 
@@ -24,9 +41,11 @@ s32 main(s32 argc, char **argv)
 		flogf(LOG_ERR, stderr, "failed to open destination file '%s' for writing.\n", DST_PATH_P);
 		exit(err);
 	}
-		
+	stats_lap(stats, STATS_OUTPUT, &clock);
+	stats_print(stderr, stats, start);
+
 
-	free(out_buf.buf);
+	arena_free(&arena);
 
 	return 0;
 }
@@ -0,0 +1,159 @@
+#include "relex.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "lexer.h"
+#include "token_table.h"
+#include "types.h"
+#include "util.h"
+
+/* Returns the old source with `edit` applied, laid out like load_source_file. */
+static struct str_buf apply_edit(struct str_buf old, SourceEdit edit)
+{
+	size_t old_len = old.len - 1; // without the NUL
+	size_t new_len = old_len - edit.deleted + edit.inserted.len;
+	char *buf = malloc(new_len + 1 + SOURCE_PADDING);
+	if (buf == NULL)
+	{
+		flogf(LOG_ERR, stderr, "failed to allocate a buffer of size %zu for '%s'\n",
+				new_len + 1 + SOURCE_PADDING, old.container_filename);
+		exit(3);
+	}
+	memcpy(buf, old.buf, edit.offset);
+	memcpy(buf + edit.offset, edit.inserted.buf, edit.inserted.len);
+	memcpy(buf + edit.offset + edit.inserted.len, old.buf + edit.offset + edit.deleted,
+			old_len - edit.offset - edit.deleted);
+	memset(buf + new_len, '\0', 1 + SOURCE_PADDING);
+	return strbuflit(buf, new_len + 1, old.container_filename);
+}
+
+/* Whether a token of this type starts where the lexer started it, outside
+ * of any literal (integer literals start after their prefix and coalesced
+ * literals after their quote, and quotes of the other kind within a literal
+ * are MiscTokens).
+ */
+static bool is_restart_type(TokenType type)
+{
+	switch (type) {
+	case MiscToken:
+	case StartStringToken:
+	case WithinStringToken:
+	case EscapeCodeStartToken:
+	case EscapeCodeToken:
+	case StringLiteralToken:
+	case EndStringToken:
+	case StartCharToken:
+	case WithinCharToken:
+	case EndCharToken:
+	case CharLiteralToken:
+	case IntegerLiteralToken:
+		return false;
+	default:
+		return true;
+	}
+}
+
+/* Returns the index of the first token of `table` at or after `offset`. */
+static size_t first_token_from(const TokenTable *table, size_t offset)
+{
+	size_t lo = 0, hi = table->len;
+	while (lo < hi)
+	{
+		size_t mid = lo + (hi - lo) / 2;
+		if (table->offsets[mid] < offset)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+/* Returns the index of the token to restart lexing at for an edit at
+ * `offset`: the last one that ends before it (so the edit can't extend it)
+ * and is a restart point. 0 means lexing restarts at the start.
+ */
+static size_t restart_index(const TokenTable *table, size_t offset)
+{
+	// token ends are ordered like their starts
+	size_t i = first_token_from(table, offset);
+	while (i > 0 && (size_t) table->offsets[i-1] + table->lengths[i-1] >= offset)
+		i--;
+	while (i > 0 && !is_restart_type(token_kind_type(table->kinds[i-1])))
+		i--;
+	return (i > 0) ? i - 1 : 0;
+}
+
+static bool outside_literal(const Lexer *lx)
+{
+	return lx->n_dquotes % 2 == 0 && lx->n_squotes % 2 == 0 && lx->in_char_for == 0
+		&& !lx->is_escaped_char;
+}
+
+RelexRange relex_edit(const TokenTable *old, SourceEdit edit, TokenTable *out)
+{
+	char *filename = old->source.container_filename;
+	size_t old_len = old->source.len - 1;
+	if (edit.offset > old_len || edit.deleted > old_len - edit.offset)
+	{
+		flogf(LOG_ERR, stderr, "edit of %zu bytes at %zu is outside of '%s' (%zu bytes)\n",
+				edit.deleted, edit.offset, filename, old_len);
+		exit(10);
+	}
+	struct str_buf source = apply_edit(old->source, edit);
+	token_table_init(out, source, filename);
+
+	size_t restart = restart_index(old, edit.offset);
+	size_t restart_offset = (restart > 0) ? old->offsets[restart] : 0;
+	token_table_append(out, old, 0, restart, 0);
+	Lexer lx;
+	lexer_setup(&lx, source, filename);
+	lx.options |= LEXER_QUIET;
+	lx.token_start_pos = lx.token_pos = source.buf + restart_offset;
+
+	// the old tokens after the edit, one of which the new stream may run into
+	s64 shift = (s64) edit.inserted.len - (s64) edit.deleted;
+	size_t next_old = first_token_from(old, edit.offset + edit.deleted);
+	RelexRange range = { .first = restart, .old_end = old->len };
+	bool resynced = false;
+	Token token;
+	while (!lx.stream_will_terminate && !is_null_token(token = lexer_next(&lx)))
+	{
+		s64 pos = token.value.buf - source.buf;
+		while (next_old < old->len && old->offsets[next_old] + shift < pos)
+			next_old++;
+		// the rest of the source is the same as after this token before,
+		// and the lexer is in the same state, so the rest of the tokens are too
+		if (next_old < old->len && old->offsets[next_old] + shift == pos
+		 && old->lengths[next_old] == token.value.len
+		 && old->kinds[next_old] == token_kind_pack(token.type, token.subtype)
+		 && outside_literal(&lx))
+		{
+			range.old_end = next_old;
+			range.new_end = out->len;
+			token_table_append(out, old, next_old, old->len, shift);
+			resynced = true;
+			break;
+		}
+		token_table_push(out, token);
+	}
+	if (!resynced)
+		range.new_end = out->len;
+	range.errflags = lx.errflags;
+	lexer_cleanup(&lx);
+
+	// the first tokens lexed again may not have been reached by the edit
+	while (range.first < range.old_end && range.first < range.new_end
+	    && (size_t) old->offsets[range.first] + old->lengths[range.first] <= edit.offset
+	    && old->offsets[range.first] == out->offsets[range.first]
+	    && old->lengths[range.first] == out->lengths[range.first]
+	    && old->kinds[range.first] == out->kinds[range.first])
+		range.first++;
+	return range;
+}
+
+void relex_free(TokenTable *table)
+{
+	free(table->source.buf);
+	token_table_free(table);
+}
@@ -0,0 +1,52 @@
+#ifndef RELEX_H
+#define RELEX_H
+
+#include <stddef.h>
+
+#include "lexer.h"
+#include "token_table.h"
+#include "types.h"
+#include "util.h"
+
+/* Incremental re-lexing after an edit, e.g. for an editor that keeps the
+ * tokens of a file up to date while it is typed in. Rather than the whole
+ * file, only the tokens around the edit are lexed again: lexing restarts at
+ * the last token that ends before the edit and starts outside of any
+ * literal (comments are never between a token's start and the lexer), and
+ * stops as soon as it produces a token that the old stream also had at the
+ * same place after the edit, with the lexer outside of any literal again.
+ * From there on, the old tokens are reused with their offsets shifted.
+ */
+
+/* `deleted` bytes at `offset` are replaced by `inserted` */
+typedef struct {
+	size_t offset;
+	size_t deleted;
+	struct str_buf inserted;
+} SourceEdit;
+
+/* Tokens [first, old_end) of the old table were replaced by tokens
+ * [first, new_end) of the new one; every other token is the same, though
+ * the ones after have moved by the size of the edit.
+ */
+typedef struct {
+	size_t first;
+	size_t old_end;
+	size_t new_end;
+	u32 errflags; /* raised while lexing the changed tokens */
+} RelexRange;
+
+/* Applies `edit` to the source of `old`, which must hold every token of
+ * that source lexed from its start with the current `lexer_options`, and
+ * fills `out` with the tokens of the result. The new source is malloc'd,
+ * NUL-terminated and padded like `load_source_file`, and becomes
+ * `out->source`; free it with `relex_free`. No diagnostics are printed,
+ * since they would only cover the tokens lexed again: if `errflags` is set,
+ * lex the whole source to report them. Exits with 10 if the edit lies
+ * outside of the source.
+ */
+RelexRange relex_edit(const TokenTable *old, SourceEdit edit, TokenTable *out);
+/* Frees a table returned by `relex_edit` and its source. */
+void relex_free(TokenTable *table);
+
+#endif /* RELEX_H */
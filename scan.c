@@ -0,0 +1,309 @@
+#include "scan.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "types.h"
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#define SCAN_X86
+#endif
+
+/* scalar versions, also used for the tail of every vectorized run */
+
+static inline bool is_space_byte(u8 c)
+{
+	return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+static inline bool is_ident_byte(u8 c)
+{
+	return ((c | 0x20) >= 'a' && (c | 0x20) <= 'z') || (c >= '0' && c <= '9') || c == '_';
+}
+
+static inline bool is_digit_byte(u8 c, DigitRadix radix)
+{
+	switch (radix) {
+	case DIGITS_DEC: return c >= '0' && c <= '9';
+	case DIGITS_HEX: return (c >= '0' && c <= '9') || ((c | 0x20) >= 'a' && (c | 0x20) <= 'f');
+	case DIGITS_OCT: return c >= '0' && c <= '7';
+	case DIGITS_BIN: return c == '0' || c == '1';
+	}
+	return false;
+}
+
+static char *scan_space_scalar(char *p, char *end)
+{
+	while (p < end && is_space_byte(*p))
+		p++;
+	return p;
+}
+
+/* `base` is where the whole scan started, which offsets are relative to */
+static char *scan_newlines_scalar(char *base, char *p, char *end, size_t *offsets, size_t *n)
+{
+	for (; p < end && *p != '\0'; ++p)
+		if (*p == '\n')
+		{
+			if (offsets != NULL)
+				offsets[*n] = p - base;
+			(*n)++;
+		}
+	return p;
+}
+
+static char *scan_ident_scalar(char *p, char *end)
+{
+	while (p < end && is_ident_byte(*p))
+		p++;
+	return p;
+}
+
+static char *scan_digits_scalar(char *p, char *end, DigitRadix radix)
+{
+	while (p < end && is_digit_byte(*p, radix))
+		p++;
+	return p;
+}
+
+#ifdef SCAN_X86
+
+/* `in_range(v, lo, hi)` sets every byte of v within [lo, hi] to 0xFF. The
+ * compares are signed, so bytes >= 0x80 never match an ASCII range.
+ */
+#define SSE_IN_RANGE(v, lo, hi) \
+	_mm_and_si128(_mm_cmpgt_epi8((v), _mm_set1_epi8((lo) - 1)), \
+	              _mm_cmpgt_epi8(_mm_set1_epi8((hi) + 1), (v)))
+#define AVX_IN_RANGE(v, lo, hi) \
+	_mm256_and_si256(_mm256_cmpgt_epi8((v), _mm256_set1_epi8((lo) - 1)), \
+	                 _mm256_cmpgt_epi8(_mm256_set1_epi8((hi) + 1), (v)))
+
+static inline __m128i sse_space_mask(__m128i v)
+{
+	return _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')), SSE_IN_RANGE(v, '\t', '\r'));
+}
+
+static inline __m128i sse_ident_mask(__m128i v)
+{
+	__m128i lower = _mm_or_si128(v, _mm_set1_epi8(0x20));
+	return _mm_or_si128(_mm_or_si128(SSE_IN_RANGE(lower, 'a', 'z'), SSE_IN_RANGE(v, '0', '9')),
+	                    _mm_cmpeq_epi8(v, _mm_set1_epi8('_')));
+}
+
+static inline __m128i sse_digit_mask(__m128i v, DigitRadix radix)
+{
+	switch (radix) {
+	case DIGITS_DEC:
+		return SSE_IN_RANGE(v, '0', '9');
+	case DIGITS_HEX:
+		return _mm_or_si128(SSE_IN_RANGE(v, '0', '9'),
+		                    SSE_IN_RANGE(_mm_or_si128(v, _mm_set1_epi8(0x20)), 'a', 'f'));
+	case DIGITS_OCT:
+		return SSE_IN_RANGE(v, '0', '7');
+	case DIGITS_BIN:
+		return SSE_IN_RANGE(v, '0', '1');
+	}
+	return _mm_setzero_si128();
+}
+
+static char *scan_space_sse2(char *p, char *end)
+{
+	for (; end - p >= 16; p += 16)
+	{
+		u32 run = _mm_movemask_epi8(sse_space_mask(_mm_loadu_si128((const __m128i *) p)));
+		if (run != 0xFFFF)
+			return p + __builtin_ctz(~run);
+	}
+	return scan_space_scalar(p, end);
+}
+
+static char *scan_ident_sse2(char *p, char *end)
+{
+	for (; end - p >= 16; p += 16)
+	{
+		u32 run = _mm_movemask_epi8(sse_ident_mask(_mm_loadu_si128((const __m128i *) p)));
+		if (run != 0xFFFF)
+			return p + __builtin_ctz(~run);
+	}
+	return scan_ident_scalar(p, end);
+}
+
+static char *scan_digits_sse2(char *p, char *end, DigitRadix radix)
+{
+	for (; end - p >= 16; p += 16)
+	{
+		u32 run = _mm_movemask_epi8(sse_digit_mask(_mm_loadu_si128((const __m128i *) p), radix));
+		if (run != 0xFFFF)
+			return p + __builtin_ctz(~run);
+	}
+	return scan_digits_scalar(p, end, radix);
+}
+
+/* Appends the offset of every bit set in `mask` (one per byte at `p`). */
+static inline void put_offsets(char *base, char *p, u32 mask, size_t *offsets, size_t *n)
+{
+	if (offsets == NULL)
+	{
+		*n += __builtin_popcount(mask);
+		return;
+	}
+	for (; mask != 0; mask &= mask - 1)
+		offsets[(*n)++] = (p - base) + __builtin_ctz(mask);
+}
+
+static char *scan_newlines_sse2(char *base, char *p, char *end, size_t *offsets, size_t *n)
+{
+	for (; end - p >= 16; p += 16)
+	{
+		__m128i v = _mm_loadu_si128((const __m128i *) p);
+		u32 nl = _mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8('\n')));
+		u32 nul = _mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_setzero_si128()));
+		if (nul != 0)
+		{
+			u32 len = __builtin_ctz(nul);
+			put_offsets(base, p, nl & ((1u << len) - 1), offsets, n);
+			return p + len;
+		}
+		put_offsets(base, p, nl, offsets, n);
+	}
+	return scan_newlines_scalar(base, p, end, offsets, n);
+}
+
+#define AVX2 __attribute__((target("avx2,popcnt,bmi")))
+
+AVX2 static inline __m256i avx_space_mask(__m256i v)
+{
+	return _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')), AVX_IN_RANGE(v, '\t', '\r'));
+}
+
+AVX2 static inline __m256i avx_ident_mask(__m256i v)
+{
+	__m256i lower = _mm256_or_si256(v, _mm256_set1_epi8(0x20));
+	return _mm256_or_si256(_mm256_or_si256(AVX_IN_RANGE(lower, 'a', 'z'), AVX_IN_RANGE(v, '0', '9')),
+	                       _mm256_cmpeq_epi8(v, _mm256_set1_epi8('_')));
+}
+
+AVX2 static inline __m256i avx_digit_mask(__m256i v, DigitRadix radix)
+{
+	switch (radix) {
+	case DIGITS_DEC:
+		return AVX_IN_RANGE(v, '0', '9');
+	case DIGITS_HEX:
+		return _mm256_or_si256(AVX_IN_RANGE(v, '0', '9'),
+		                       AVX_IN_RANGE(_mm256_or_si256(v, _mm256_set1_epi8(0x20)), 'a', 'f'));
+	case DIGITS_OCT:
+		return AVX_IN_RANGE(v, '0', '7');
+	case DIGITS_BIN:
+		return AVX_IN_RANGE(v, '0', '1');
+	}
+	return _mm256_setzero_si256();
+}
+
+AVX2 static char *scan_space_avx2(char *p, char *end)
+{
+	for (; end - p >= 32; p += 32)
+	{
+		u32 run = _mm256_movemask_epi8(avx_space_mask(_mm256_loadu_si256((const __m256i *) p)));
+		if (run != 0xFFFFFFFF)
+			return p + __builtin_ctz(~run);
+	}
+	return scan_space_sse2(p, end);
+}
+
+AVX2 static char *scan_ident_avx2(char *p, char *end)
+{
+	for (; end - p >= 32; p += 32)
+	{
+		u32 run = _mm256_movemask_epi8(avx_ident_mask(_mm256_loadu_si256((const __m256i *) p)));
+		if (run != 0xFFFFFFFF)
+			return p + __builtin_ctz(~run);
+	}
+	return scan_ident_sse2(p, end);
+}
+
+AVX2 static char *scan_digits_avx2(char *p, char *end, DigitRadix radix)
+{
+	for (; end - p >= 32; p += 32)
+	{
+		u32 run = _mm256_movemask_epi8(avx_digit_mask(_mm256_loadu_si256((const __m256i *) p), radix));
+		if (run != 0xFFFFFFFF)
+			return p + __builtin_ctz(~run);
+	}
+	return scan_digits_sse2(p, end, radix);
+}
+
+AVX2 static char *scan_newlines_avx2(char *base, char *p, char *end, size_t *offsets, size_t *n)
+{
+	for (; end - p >= 32; p += 32)
+	{
+		__m256i v = _mm256_loadu_si256((const __m256i *) p);
+		u32 nl = _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n')));
+		u32 nul = _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_setzero_si256()));
+		if (nul != 0)
+		{
+			u32 len = __builtin_ctz(nul);
+			put_offsets(base, p, nl & (u32) ((1ull << len) - 1), offsets, n);
+			return p + len;
+		}
+		put_offsets(base, p, nl, offsets, n);
+	}
+	return scan_newlines_sse2(base, p, end, offsets, n);
+}
+
+#endif /* SCAN_X86 */
+
+static char *(*scan_space_impl)(char *, char *) = scan_space_scalar;
+static char *(*scan_ident_impl)(char *, char *) = scan_ident_scalar;
+static char *(*scan_digits_impl)(char *, char *, DigitRadix) = scan_digits_scalar;
+static char *(*scan_newlines_impl)(char *, char *, char *, size_t *, size_t *) = scan_newlines_scalar;
+static const char *scan_impl = "scalar";
+
+__attribute__((constructor))
+static void scan_select_impl(void)
+{
+#ifdef SCAN_X86
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2"))
+	{
+		scan_space_impl = scan_space_avx2;
+		scan_ident_impl = scan_ident_avx2;
+		scan_digits_impl = scan_digits_avx2;
+		scan_newlines_impl = scan_newlines_avx2;
+		scan_impl = "avx2";
+	} else if (__builtin_cpu_supports("sse2"))
+	{
+		scan_space_impl = scan_space_sse2;
+		scan_ident_impl = scan_ident_sse2;
+		scan_digits_impl = scan_digits_sse2;
+		scan_newlines_impl = scan_newlines_sse2;
+		scan_impl = "sse2";
+	}
+#endif
+}
+
+char *scan_space(char *p, char *end)
+{
+	return scan_space_impl(p, end);
+}
+
+char *scan_ident(char *p, char *end)
+{
+	return scan_ident_impl(p, end);
+}
+
+char *scan_digits(char *p, char *end, DigitRadix radix)
+{
+	return scan_digits_impl(p, end, radix);
+}
+
+char *scan_newlines(char *p, char *end, size_t *offsets, size_t *n_newlines)
+{
+	*n_newlines = 0;
+	return scan_newlines_impl(p, p, end, offsets, n_newlines);
+}
+
+const char *scan_impl_name(void)
+{
+	return scan_impl;
+}
@@ -0,0 +1,37 @@
+#ifndef SCAN_H
+#define SCAN_H
+
+#include <stddef.h>
+
+#include "types.h"
+
+/* Vectorized kernels that find the end of a run of bytes of one class.
+ * Each returns a pointer to the first byte in [p, end) that is not part of
+ * the run, or `end`. They never read at or past `end`, and a '\0' always
+ * ends a run. The implementation (AVX2, SSE2 or scalar) is picked once at
+ * startup from what the CPU supports.
+ */
+
+typedef enum {
+	DIGITS_DEC,
+	DIGITS_HEX,
+	DIGITS_OCT,
+	DIGITS_BIN,
+} DigitRadix;
+
+/* whitespace as in isspace() */
+char *scan_space(char *p, char *end);
+/* identifier characters: [A-Za-z0-9_] */
+char *scan_ident(char *p, char *end);
+/* digits of `radix` */
+char *scan_digits(char *p, char *end, DigitRadix radix);
+/* anything but '\0', i.e. up to the end of the text: sets `*n_newlines` to
+ * the number of '\n's in the run and, unless `offsets` is NULL, writes the
+ * offset of each from `p` to it (so it must have room for all of them).
+ */
+char *scan_newlines(char *p, char *end, size_t *offsets, size_t *n_newlines);
+
+/* name of the selected implementation, e.g. for benchmarks */
+const char *scan_impl_name(void);
+
+#endif /* SCAN_H */
@@ -0,0 +1,161 @@
+#include "stats.h"
+
+#include <time.h>
+
+#include "lexer.h"
+#include "types.h"
+#include "util.h"
+
+static const char *phase_names[N_STATS_PHASES] = {
+	[STATS_READ] = "read",
+	[STATS_STRIP] = "strip_comments",
+	[STATS_LEX] = "lex",
+	[STATS_OUTPUT] = "output",
+};
+
+static const char *type_names[FileEndToken + 1] = {
+	[MiscToken] = "MiscToken",
+	[IdentifierToken] = "IdentifierToken",
+	[StartStringToken] = "StartStringToken",
+	[WithinStringToken] = "WithinStringToken",
+	[EscapeCodeStartToken] = "EscapeCodeStartToken",
+	[EscapeCodeToken] = "EscapeCodeToken",
+	[StringLiteralToken] = "StringLiteralToken",
+	[EndStringToken] = "EndStringToken",
+	[StartCharToken] = "StartCharToken",
+	[WithinCharToken] = "WithinCharToken",
+	[EndCharToken] = "EndCharToken",
+	[CharLiteralToken] = "CharLiteralToken",
+	[VarTypeInferInitToken] = "VarTypeInferInitToken",
+	[OperatorToken] = "OperatorToken",
+	[StartBlockToken] = "StartBlockToken",
+	[EndBlockToken] = "EndBlockToken",
+	[StartParenToken] = "StartParenToken",
+	[EndParenToken] = "EndParenToken",
+	[StartBracketToken] = "StartBracketToken",
+	[EndBracketToken] = "EndBracketToken",
+	[EndStatementToken] = "EndStatementToken",
+	[ItemSeparatorToken] = "ItemSeparatorToken",
+	[VariableArgumentIndicatorToken] = "VariableArgumentIndicatorToken",
+	[ReturnTypeIndicatorToken] = "ReturnTypeIndicatorToken",
+	[IntegerLiteralToken] = "IntegerLiteralToken",
+	[FileEndToken] = "FileEndToken",
+};
+
+static const char *subtype_names[BIN_INT_LITERAL + 1] = {
+	[ERROR_TOKEN] = "ERROR_TOKEN",
+	[GROUPING_TOKEN] = "GROUPING_TOKEN",
+	[NOT_IDENTIFIER] = "NOT_IDENTIFIER",
+	[NORMAL_IDENTIFIER] = "NORMAL_IDENTIFIER",
+	[FUNC_KEYWORD] = "FUNC_KEYWORD",
+	[TYPE_KEYWORD] = "TYPE_KEYWORD",
+	[RETURN_KEYWORD] = "RETURN_KEYWORD",
+	[RESERVED_KEYWORD] = "RESERVED_KEYWORD",
+	[DEC_INT_LITERAL] = "DEC_INT_LITERAL",
+	[HEX_INT_LITERAL] = "HEX_INT_LITERAL",
+	[OCT_INT_LITERAL] = "OCT_INT_LITERAL",
+	[BIN_INT_LITERAL] = "BIN_INT_LITERAL",
+};
+
+static u64 clock_ns(clockid_t id)
+{
+	struct timespec ts;
+	clock_gettime(id, &ts);
+	return (u64) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+StatsClock stats_clock(void)
+{
+	return (StatsClock) { clock_ns(CLOCK_MONOTONIC), clock_ns(CLOCK_THREAD_CPUTIME_ID) };
+}
+
+void stats_lap(Stats *stats, StatsPhase phase, StatsClock *since)
+{
+	if (stats == NULL)
+		return;
+	StatsClock now = stats_clock();
+	stats->wall_ns[phase] += now.wall_ns - since->wall_ns;
+	stats->cpu_ns[phase] += now.cpu_ns - since->cpu_ns;
+	*since = now;
+}
+
+void stats_count_tokens(Stats *stats, const Token *tokens, size_t n_tokens)
+{
+	if (stats == NULL)
+		return;
+	for (size_t i = 0; i < n_tokens; ++i)
+	{
+		if (tokens[i].type <= FileEndToken)
+		{
+			stats->type_tokens[tokens[i].type]++;
+			stats->type_bytes[tokens[i].type] += tokens[i].value.len;
+		}
+		if (tokens[i].subtype <= BIN_INT_LITERAL)
+			stats->subtype_tokens[tokens[i].subtype]++;
+	}
+}
+
+void stats_merge(Stats *dst, const Stats *src)
+{
+	if (dst == NULL)
+		return;
+	for (size_t i = 0; i < N_STATS_PHASES; ++i)
+	{
+		dst->wall_ns[i] += src->wall_ns[i];
+		dst->cpu_ns[i] += src->cpu_ns[i];
+	}
+	dst->n_files += src->n_files;
+	dst->source_bytes += src->source_bytes;
+	dst->comment_bytes += src->comment_bytes;
+	for (size_t i = 0; i <= FileEndToken; ++i)
+	{
+		dst->type_tokens[i] += src->type_tokens[i];
+		dst->type_bytes[i] += src->type_bytes[i];
+	}
+	for (size_t i = 0; i <= BIN_INT_LITERAL; ++i)
+		dst->subtype_tokens[i] += src->subtype_tokens[i];
+}
+
+void stats_print(FILE *stream, const Stats *stats, StatsClock start)
+{
+	if (stats == NULL)
+		return;
+	u64 elapsed_ns = clock_ns(CLOCK_MONOTONIC) - start.wall_ns;
+	u64 process_cpu_ns = clock_ns(CLOCK_PROCESS_CPUTIME_ID);
+
+	flogf(LOG_INFO, stream, "stats for %" PRIu64 " file(s), %" PRIu64 " bytes:\n",
+			stats->n_files, stats->source_bytes);
+	fprintf(stream, "  %-32s %12s %12s\n", "phase", "wall ms", "cpu ms");
+	for (size_t i = 0; i < N_STATS_PHASES; ++i)
+		fprintf(stream, "  %-32s %12.3f %12.3f\n", phase_names[i],
+				stats->wall_ns[i] / 1e6, stats->cpu_ns[i] / 1e6);
+	fprintf(stream, "  %-32s %12.3f %12.3f\n", "total (elapsed, process)",
+			elapsed_ns / 1e6, process_cpu_ns / 1e6);
+
+	u64 n_tokens = 0;
+	for (size_t i = 0; i <= FileEndToken; ++i)
+		n_tokens += stats->type_tokens[i];
+	if (n_tokens > 0)
+	{
+		fprintf(stream, "  %-32s %12s %12s\n", "token type", "tokens", "bytes");
+		for (size_t i = 0; i <= FileEndToken; ++i)
+			if (stats->type_tokens[i] > 0)
+				fprintf(stream, "  %-32s %12" PRIu64 " %12" PRIu64 "\n",
+						(type_names[i] != NULL) ? type_names[i] : "?",
+						stats->type_tokens[i], stats->type_bytes[i]);
+		fprintf(stream, "  %-32s %12s\n", "token subtype", "tokens");
+		for (size_t i = 0; i <= BIN_INT_LITERAL; ++i)
+			if (stats->subtype_tokens[i] > 0)
+				fprintf(stream, "  %-32s %12" PRIu64 "\n",
+						(subtype_names[i] != NULL) ? subtype_names[i] : "?",
+						stats->subtype_tokens[i]);
+		// keyword_type() classifies every identifier, so its hits are the
+		// keywords and its misses the other identifiers
+		u64 hits = stats->subtype_tokens[FUNC_KEYWORD] + stats->subtype_tokens[TYPE_KEYWORD]
+			+ stats->subtype_tokens[RETURN_KEYWORD] + stats->subtype_tokens[RESERVED_KEYWORD];
+		fprintf(stream, "  %-32s %12" PRIu64 " hits, %" PRIu64 " misses\n", "keyword_type()",
+				hits, stats->subtype_tokens[NORMAL_IDENTIFIER]);
+		fprintf(stream, "  %-32s %12" PRIu64 "\n", "total tokens", n_tokens);
+	}
+	fprintf(stream, "  %-32s %12" PRIu64 "\n", "comment bytes removed", stats->comment_bytes);
+}
@@ -0,0 +1,57 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdio.h>
+
+#include "lexer.h"
+#include "types.h"
+
+/* Counters printed at the end of a run with --stats: time spent in each
+ * phase and what the tokens were made of. Tokens are counted per batch
+ * after the lexer returns them and the clocks are read once per batch, so
+ * the lexer itself does no extra work. Each thread fills its own `Stats`,
+ * which are added up with `stats_merge` before printing.
+ *
+ * Every function taking a `Stats *` does nothing if it's NULL, i.e. if
+ * --stats wasn't given.
+ *
+ * A single file lexed in parallel (see lex_parallel.h) only counts the CPU
+ * time of the thread waiting for the others, and not its comment bytes.
+ */
+
+typedef enum {
+	STATS_READ,
+	STATS_STRIP,
+	STATS_LEX,
+	STATS_OUTPUT,
+	N_STATS_PHASES,
+} StatsPhase;
+
+/* a point in time on the wall clock and on the calling thread's CPU clock */
+typedef struct {
+	u64 wall_ns;
+	u64 cpu_ns;
+} StatsClock;
+
+typedef struct {
+	u64 wall_ns[N_STATS_PHASES]; /* summed over threads */
+	u64 cpu_ns[N_STATS_PHASES];
+	u64 n_files;
+	u64 source_bytes;
+	u64 comment_bytes; /* removed by strip_comments or skipped by the lexer */
+	u64 type_tokens[FileEndToken + 1]; /* by TokenType */
+	u64 type_bytes[FileEndToken + 1];
+	u64 subtype_tokens[BIN_INT_LITERAL + 1]; /* by TokenSubType */
+} Stats;
+
+StatsClock stats_clock(void);
+/* Adds the time since `*since` to `phase` and moves `*since` up to now. */
+void stats_lap(Stats *stats, StatsPhase phase, StatsClock *since);
+void stats_count_tokens(Stats *stats, const Token *tokens, size_t n_tokens);
+void stats_merge(Stats *dst, const Stats *src);
+/* `start` is when the run started, to tell the phases (which threads can
+ * overlap in) from the elapsed time.
+ */
+void stats_print(FILE *stream, const Stats *stats, StatsClock start);
+
+#endif /* STATS_H */
@@ -0,0 +1,153 @@
+#include "structural.h"
+
+#include <stdbool.h>
+#include <string.h>
+
+#include "types.h"
+#include "util.h"
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#define SIDX_X86
+#endif
+
+typedef struct {
+	u64 quote, escape, literal;
+} BlockBits;
+
+/* bitmask of the bytes in p[0..64) equal to `c` */
+static inline u64 eq_mask(const char *p, char c)
+{
+#ifdef SIDX_X86
+	__m128i needle = _mm_set1_epi8(c);
+	u64 mask = 0;
+	for (s32 i = 0; i < 4; ++i)
+		mask |= (u64) (u32) _mm_movemask_epi8(
+				_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *) (p + 16*i)), needle)) << (16*i);
+	return mask;
+#else
+	u64 mask = 0;
+	for (s32 i = 0; i < 64; ++i)
+		mask |= (u64) (p[i] == c) << i;
+	return mask;
+#endif
+}
+
+/* every bit set iff an odd number of bits at or below it are set in `x` */
+static inline u64 prefix_xor(u64 x)
+{
+	x ^= x << 1;
+	x ^= x << 2;
+	x ^= x << 4;
+	x ^= x << 8;
+	x ^= x << 16;
+	x ^= x << 32;
+	return x;
+}
+
+/* Bytes escaped by a preceding backslash, assuming every backslash in the
+ * block is inside a literal: the byte after each odd-length backslash run.
+ * `*prev_escaped` is whether the block's first byte is escaped on input and
+ * whether the next block's is on output.
+ */
+static inline u64 find_escaped(u64 backslash, bool *prev_escaped)
+{
+	const u64 even_bits = 0x5555555555555555ull;
+	backslash &= ~(u64) *prev_escaped;
+	u64 follows_escape = (backslash << 1) | *prev_escaped;
+	// runs starting on odd bits, added to the runs themselves, carry to the
+	// bit after each run; that flips the parity for runs starting on even bits
+	u64 odd_sequence_starts = backslash & ~even_bits & ~follows_escape;
+	u64 sequences_starting_on_even_bits;
+	*prev_escaped = __builtin_add_overflow(odd_sequence_starts, backslash, &sequences_starting_on_even_bits);
+	u64 invert_mask = sequences_starting_on_even_bits << 1;
+	return (even_bits ^ invert_mask) & follows_escape;
+}
+
+/* Byte-at-a-time indexing of p[0..n), for blocks the bitwise path can't do. */
+static BlockBits index_scalar(const char *p, size_t n, SidxState *state, bool *escaped)
+{
+	BlockBits bits = {0};
+	for (size_t i = 0; i < n; ++i)
+	{
+		u64 bit = 1ull << i;
+		if (*state == SIDX_OUTSIDE)
+		{
+			if (p[i] == '"' || p[i] == '\'')
+			{
+				bits.quote |= bit;
+				*state = (p[i] == '"') ? SIDX_IN_STRING : SIDX_IN_CHAR;
+			}
+		} else if (*escaped)
+		{
+			bits.literal |= bit;
+			*escaped = false;
+		} else if (p[i] == '\\')
+		{
+			bits.escape |= bit;
+			*escaped = true;
+		} else if (p[i] == ((*state == SIDX_IN_STRING) ? '"' : '\''))
+		{
+			bits.quote |= bit;
+			*state = SIDX_OUTSIDE;
+		} else
+			bits.literal |= bit;
+	}
+	return bits;
+}
+
+/* Indexes one full 64-byte block. */
+static BlockBits index_block(const char *p, SidxState *state, bool *escaped)
+{
+	if (*state != SIDX_IN_CHAR)
+	{
+		u64 backslash = eq_mask(p, '\\');
+		u64 dquote = eq_mask(p, '"');
+		u64 squote = eq_mask(p, '\'');
+
+		bool next_escaped = *escaped;
+		u64 escaped_bits = find_escaped(backslash, &next_escaped);
+		u64 quote = dquote & ~escaped_bits;
+		// set from each opening quote up to (not including) its closing quote
+		u64 in_string = prefix_xor(quote) ^ ((*state == SIDX_IN_STRING) ? ~0ull : 0);
+
+		// a char literal or a backslash outside of a string needs the slow path
+		if (((squote | backslash) & ~in_string) == 0)
+		{
+			BlockBits bits;
+			bits.quote = quote;
+			bits.escape = backslash & ~escaped_bits;
+			bits.literal = in_string & ~quote & ~bits.escape;
+			*state = (in_string >> 63) ? SIDX_IN_STRING : SIDX_OUTSIDE;
+			*escaped = next_escaped;
+			return bits;
+		}
+	}
+	return index_scalar(p, 64, state, escaped);
+}
+
+void structural_index(StructuralIndex *idx, char *start, char *end, SidxState state, bool escaped)
+{
+	idx->end = end;
+	idx->window_start = start;
+	idx->window_end = start + MIN((size_t) (end - start), SIDX_WINDOW_SIZE);
+
+	size_t n = idx->window_end - start;
+	for (size_t block = 0; block*64 < n; ++block)
+	{
+		char *p = start + block*64;
+		BlockBits bits = (n - block*64 >= 64)
+			? index_block(p, &state, &escaped)
+			: index_scalar(p, n - block*64, &state, &escaped);
+		idx->quote_bits[block] = bits.quote;
+		idx->escape_bits[block] = bits.escape;
+		idx->literal_bits[block] = bits.literal;
+	}
+	idx->state = state;
+	idx->next_is_escaped = escaped;
+}
+
+void structural_next_window(StructuralIndex *idx)
+{
+	structural_index(idx, idx->window_end, idx->end, idx->state, idx->next_is_escaped);
+}
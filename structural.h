@@ -0,0 +1,77 @@
+#ifndef STRUCTURAL_H
+#define STRUCTURAL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "types.h"
+
+/* A structural index over a window of the source, computed 64 bytes at a
+ * time. For each byte it records whether it is a structural quote (one that
+ * opens or closes a literal), a backslash that starts an escape sequence, or
+ * part of a literal's body. Escapes are resolved by finding odd-length
+ * backslash runs and literal regions with a prefix XOR over the quote bits,
+ * so blocks that only contain string literals are indexed without looking
+ * at each byte; blocks with char literals or stray backslashes fall back to
+ * a byte-at-a-time scan with the same result.
+ *
+ * Backslashes only escape anything inside a literal, and a literal is only
+ * closed by its own (unescaped) quote kind.
+ */
+
+#define SIDX_WINDOW_BLOCKS 16
+#define SIDX_WINDOW_SIZE (SIDX_WINDOW_BLOCKS * 64)
+
+typedef enum {
+	SIDX_OUTSIDE,   /* not inside a literal */
+	SIDX_IN_STRING, /* after an opening '"' */
+	SIDX_IN_CHAR,   /* after an opening '\'' */
+} SidxState;
+
+typedef enum {
+	SIDX_OTHER = 0, /* outside of any literal */
+	SIDX_QUOTE,     /* a quote that opens or closes a literal */
+	SIDX_ESCAPE,    /* a backslash that escapes the byte after it */
+	SIDX_LITERAL,   /* any other byte inside a literal (including escaped ones) */
+} SidxClass;
+
+typedef struct {
+	char *end; /* never index at or past this */
+	char *window_start;
+	char *window_end;
+	u64 quote_bits[SIDX_WINDOW_BLOCKS];
+	u64 escape_bits[SIDX_WINDOW_BLOCKS];
+	u64 literal_bits[SIDX_WINDOW_BLOCKS];
+	/* state right after the window, used to continue into the next one */
+	SidxState state;
+	bool next_is_escaped;
+} StructuralIndex;
+
+/* Indexes the window starting at `start`, in `state`, with the first byte
+ * escaped iff `escaped`. The window ends at `end` at the latest.
+ */
+void structural_index(StructuralIndex *idx, char *start, char *end, SidxState state, bool escaped);
+
+/* Indexes the window right after the current one, carrying its end state. */
+void structural_next_window(StructuralIndex *idx);
+
+static inline bool structural_covers(const StructuralIndex *idx, const char *pos)
+{
+	return pos >= idx->window_start && pos < idx->window_end;
+}
+
+/* Class of the byte at `pos`, which must be covered by the window. */
+static inline SidxClass structural_class(const StructuralIndex *idx, const char *pos)
+{
+	size_t off = pos - idx->window_start;
+	u64 bit = 1ull << (off % 64);
+	if (idx->quote_bits[off / 64] & bit)
+		return SIDX_QUOTE;
+	if (idx->escape_bits[off / 64] & bit)
+		return SIDX_ESCAPE;
+	if (idx->literal_bits[off / 64] & bit)
+		return SIDX_LITERAL;
+	return SIDX_OTHER;
+}
+
+#endif /* STRUCTURAL_H */
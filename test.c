@@ -9,8 +9,9 @@ s32 main(s32 argc, char **argv)
 {
 	parse_args_preproc(argc, argv, print_usage_msg_lexer, &SRC_PATH_L, NULL);
 
+	Arena arena = {0};
 	struct str_buf src_contents = read_file_to_string(SRC_PATH_L);
-	struct str_buf file_contents = strip_comments(src_contents, SRC_PATH_L);
+	struct str_buf file_contents = strip_comments(src_contents, SRC_PATH_L, &arena);
 	free(src_contents.buf);
 
 	lexer_init(file_contents);
@@ -31,6 +32,7 @@ s32 main(s32 argc, char **argv)
 			 esc_str.buf);
 	}
 	freetmp();
+	arena_free(&arena);
 
 	return 0;
 }
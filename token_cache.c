@@ -0,0 +1,311 @@
+#include "token_cache.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "types.h"
+#include "util.h"
+
+/* "<source hash>-<fingerprint>", both in hex */
+#define ENTRY_NAME_LEN 33
+#define TMP_PREFIX ".tmp-"
+/* a temporary file this old was left behind by a run that didn't finish */
+#define STALE_TMP_AGE (60 * 60) /* seconds */
+
+static u64 now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (u64) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/* Returns the malloc'd path of `name` in the cache directory. */
+static char *cache_path(const TokenCache *cache, const char *name)
+{
+	size_t len = strlen(cache->dir) + 1 + strlen(name) + 1;
+	char *path = malloc(len);
+	if (path == NULL)
+	{
+		flogf(LOG_ERR, stderr, "failed to allocate a path in '%s'\n", cache->dir);
+		exit(3);
+	}
+	snprintf(path, len, "%s/%s", cache->dir, name);
+	return path;
+}
+
+static char *entry_path(const TokenCache *cache, u64 key)
+{
+	char name[ENTRY_NAME_LEN + 1];
+	snprintf(name, sizeof(name), "%016" PRIx64 "-%016" PRIx64, key, cache->fingerprint);
+	return cache_path(cache, name);
+}
+
+static bool is_entry_name(const char *name)
+{
+	return strlen(name) == ENTRY_NAME_LEN && name[16] == '-';
+}
+
+bool token_cache_open(TokenCache *cache, const char *dir, u64 max_size, u64 fingerprint)
+{
+	*cache = (TokenCache) {0};
+	if (mkdir(dir, 0777) != 0 && errno != EEXIST)
+	{
+		flogf(LOG_WARN, stderr, "can't create cache directory '%s' (%s); not caching\n",
+				dir, strerror(errno));
+		return false;
+	}
+	if (access(dir, R_OK | W_OK | X_OK) != 0)
+	{
+		flogf(LOG_WARN, stderr, "can't use cache directory '%s' (%s); not caching\n",
+				dir, strerror(errno));
+		return false;
+	}
+	cache->dir = dir;
+	cache->max_size = max_size;
+	cache->fingerprint = fingerprint;
+	pthread_mutex_init(&cache->lock, NULL);
+	return true;
+}
+
+u64 token_cache_hash(TokenCache *cache, struct str_buf source)
+{
+	if (cache == NULL)
+		return 0;
+	u64 start = now_ns();
+	u64 key = hash_bytes(source.buf, source.len, 0);
+	u64 elapsed = now_ns() - start;
+	pthread_mutex_lock(&cache->lock);
+	cache->hashed_bytes += source.len;
+	cache->hash_ns += elapsed;
+	pthread_mutex_unlock(&cache->lock);
+	return key;
+}
+
+/* Maps the entry at `path` into `out` if it is one for `key` and `source`. */
+static bool map_entry(const TokenCache *cache, const char *path, u64 key, struct str_buf source,
+		TokenCacheEntry *out)
+{
+	s32 fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return false;
+	struct stat st;
+	if (fstat(fd, &st) != 0 || (size_t) st.st_size < sizeof(TokenCacheHeader))
+	{
+		close(fd);
+		return false;
+	}
+	void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (map == MAP_FAILED)
+	{
+		close(fd);
+		return false;
+	}
+	// the entry was used just now, which is what eviction goes by
+	futimens(fd, NULL);
+	close(fd);
+
+	const TokenCacheHeader *header = map;
+	if (memcmp(header->magic, TOKEN_CACHE_MAGIC, sizeof(header->magic)) != 0
+	 || header->fingerprint != cache->fingerprint || header->source_hash != key
+	 || header->source_len != source.len
+	 || header->data_len != st.st_size - sizeof(TokenCacheHeader))
+	{
+		munmap(map, st.st_size);
+		return false;
+	}
+	*out = (TokenCacheEntry) { header, (const u8 *) (header + 1), st.st_size };
+	return true;
+}
+
+bool token_cache_get(TokenCache *cache, u64 key, struct str_buf source, TokenCacheEntry *out)
+{
+	if (cache == NULL)
+		return false;
+	char *path = entry_path(cache, key);
+	bool hit = map_entry(cache, path, key, source, out);
+	free(path);
+	pthread_mutex_lock(&cache->lock);
+	if (hit)
+	{
+		cache->n_hits++;
+		cache->hit_bytes += out->header->data_len;
+	} else
+		cache->n_misses++;
+	pthread_mutex_unlock(&cache->lock);
+	return hit;
+}
+
+void token_cache_release(TokenCacheEntry *entry)
+{
+	munmap((void *) entry->header, entry->map_size);
+	*entry = (TokenCacheEntry) {0};
+}
+
+static bool write_all(s32 fd, const void *buf, size_t len)
+{
+	const u8 *p = buf;
+	while (len > 0)
+	{
+		ssize_t n = write(fd, p, len);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			return false;
+		p += n;
+		len -= n;
+	}
+	return true;
+}
+
+void token_cache_put(TokenCache *cache, u64 key, struct str_buf source, s32 status,
+		u64 comment_bytes, const void *data, size_t len)
+{
+	if (cache == NULL)
+		return;
+	TokenCacheHeader header = {
+		.magic = TOKEN_CACHE_MAGIC,
+		.fingerprint = cache->fingerprint,
+		.source_hash = key,
+		.source_len = source.len,
+		.comment_bytes = comment_bytes,
+		.data_len = len,
+		.status = status,
+	};
+	// written aside and renamed into place, so readers never see half of it
+	char *tmp_path = cache_path(cache, TMP_PREFIX "XXXXXX");
+	s32 fd = mkstemp(tmp_path);
+	if (fd < 0)
+	{
+		free(tmp_path);
+		return;
+	}
+	bool ok = write_all(fd, &header, sizeof(header)) && write_all(fd, data, len);
+	ok = (close(fd) == 0) && ok;
+	char *path = entry_path(cache, key);
+	if (ok)
+		ok = (rename(tmp_path, path) == 0);
+	if (!ok)
+		unlink(tmp_path);
+	free(path);
+	free(tmp_path);
+	if (!ok)
+		return;
+	pthread_mutex_lock(&cache->lock);
+	cache->n_stored++;
+	cache->stored_bytes += sizeof(header) + len;
+	pthread_mutex_unlock(&cache->lock);
+}
+
+typedef struct {
+	char *name;
+	struct timespec mtime;
+	u64 size;
+} CachedFile;
+
+static int cmp_least_recent_first(const void *a, const void *b)
+{
+	const struct timespec *ta = &((const CachedFile *) a)->mtime;
+	const struct timespec *tb = &((const CachedFile *) b)->mtime;
+	if (ta->tv_sec != tb->tv_sec)
+		return (ta->tv_sec < tb->tv_sec) ? -1 : 1;
+	if (ta->tv_nsec != tb->tv_nsec)
+		return (ta->tv_nsec < tb->tv_nsec) ? -1 : 1;
+	return 0;
+}
+
+/* Removes the least recently used entries until the cache fits in its
+ * limit, whichever run (or fingerprint) they are from, and any temporary
+ * files older than STALE_TMP_AGE.
+ */
+static void evict(TokenCache *cache)
+{
+	DIR *dir = opendir(cache->dir);
+	if (dir == NULL)
+		return;
+	CachedFile *files = NULL;
+	size_t n_files = 0, capacity = 0;
+	u64 size = 0;
+	time_t now = time(NULL);
+	struct dirent *ent;
+	while ((ent = readdir(dir)) != NULL)
+	{
+		bool is_tmp = (strncmp(ent->d_name, TMP_PREFIX, strlen(TMP_PREFIX)) == 0);
+		if (!is_tmp && !is_entry_name(ent->d_name))
+			continue;
+		struct stat st;
+		if (fstatat(dirfd(dir), ent->d_name, &st, 0) != 0 || !S_ISREG(st.st_mode))
+			continue;
+		if (is_tmp)
+		{
+			// younger ones may still be written by a concurrent run
+			if (now - st.st_mtim.tv_sec > STALE_TMP_AGE)
+				unlinkat(dirfd(dir), ent->d_name, 0);
+			continue;
+		}
+		if (n_files == capacity)
+		{
+			capacity = MAX(capacity * 2, 64);
+			CachedFile *new_files = realloc(files, capacity * sizeof(CachedFile));
+			if (new_files == NULL)
+			{
+				flogf(LOG_ERR, stderr, "failed to reallocate the cache entry list\n");
+				exit(4);
+			}
+			files = new_files;
+		}
+		files[n_files++] = (CachedFile) { strdup(ent->d_name), st.st_mtim, st.st_size };
+		size += st.st_size;
+	}
+	if (size > cache->max_size)
+	{
+		qsort(files, n_files, sizeof(CachedFile), cmp_least_recent_first);
+		for (size_t i = 0; i < n_files && size > cache->max_size; ++i)
+		{
+			if (files[i].name == NULL || unlinkat(dirfd(dir), files[i].name, 0) != 0)
+				continue;
+			size -= files[i].size;
+			cache->n_evicted++;
+			cache->evicted_bytes += files[i].size;
+		}
+	}
+	cache->size = size;
+	for (size_t i = 0; i < n_files; ++i)
+		free(files[i].name);
+	free(files);
+	closedir(dir);
+}
+
+void token_cache_close(TokenCache *cache)
+{
+	if (cache == NULL)
+		return;
+	evict(cache);
+	pthread_mutex_destroy(&cache->lock);
+}
+
+void token_cache_print_stats(FILE *stream, const TokenCache *cache)
+{
+	if (cache == NULL)
+		return;
+	u64 n_lookups = cache->n_hits + cache->n_misses;
+	flogf(LOG_INFO, stream, "token cache '%s':\n", cache->dir);
+	fprintf(stream, "  %-32s %12" PRIu64 " of %" PRIu64 " (%.1f%%)\n", "hits", cache->n_hits,
+			n_lookups, (n_lookups > 0) ? 100.0 * cache->n_hits / n_lookups : 0.0);
+	fprintf(stream, "  %-32s %12" PRIu64 "\n", "misses", cache->n_misses);
+	fprintf(stream, "  %-32s %12" PRIu64 " bytes in %.3f ms\n", "hashed",
+			cache->hashed_bytes, cache->hash_ns / 1e6);
+	fprintf(stream, "  %-32s %12" PRIu64 " bytes\n", "read from hits", cache->hit_bytes);
+	fprintf(stream, "  %-32s %12" PRIu64 " entries, %" PRIu64 " bytes\n", "stored",
+			cache->n_stored, cache->stored_bytes);
+	fprintf(stream, "  %-32s %12" PRIu64 " entries, %" PRIu64 " bytes\n", "evicted",
+			cache->n_evicted, cache->evicted_bytes);
+	fprintf(stream, "  %-32s %12" PRIu64 " of %" PRIu64 " bytes\n", "size",
+			cache->size, cache->max_size);
+}
@@ -0,0 +1,82 @@
+#ifndef TOKEN_CACHE_H
+#define TOKEN_CACHE_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "types.h"
+#include "util.h"
+
+/* An on-disk cache of lexer output (--cache-dir), so that a file that hasn't
+ * changed since the last run costs one hash of its contents instead of a
+ * full lex. Entries are keyed by the hash of the source and the lexer's
+ * fingerprint (see `lexer_fingerprint`), which also covers the output
+ * format, and hold whatever the caller stored for it: the text output, or
+ * the token table for --format=bin.
+ *
+ * Entries are written to a temporary file and renamed into place, so
+ * concurrent runs sharing a directory only ever see whole entries. Reading
+ * an entry bumps its modification time; when the cache is closed the least
+ * recently used entries are removed until it fits in its size limit, along
+ * with temporary files that a crashed run left behind.
+ *
+ * Every function taking a `TokenCache *` does nothing (and finds nothing)
+ * if it's NULL, i.e. if --cache-dir wasn't given. The functions are safe
+ * to call from several threads at once.
+ */
+
+#define TOKEN_CACHE_MAGIC "ATPCACH" /* with its NUL, fills `magic` */
+#define TOKEN_CACHE_DEFAULT_SIZE (256ULL << 20)
+
+typedef struct {
+	char magic[8];
+	u64 fingerprint;
+	u64 source_hash;
+	u64 source_len; /* including the terminating NUL, like `SourceFile` */
+	u64 comment_bytes; /* skipped by the lexer, for --stats */
+	u64 data_len;
+	s32 status; /* the lexer's exit code for the file */
+	u32 reserved;
+} TokenCacheHeader;
+
+/* a cache entry that was found, mapped until `token_cache_release` */
+typedef struct {
+	const TokenCacheHeader *header;
+	const u8 *data; /* `header->data_len` bytes */
+	size_t map_size;
+} TokenCacheEntry;
+
+typedef struct {
+	const char *dir; /* not copied */
+	u64 max_size;
+	u64 fingerprint;
+	pthread_mutex_t lock; /* for the counters */
+	u64 n_hits, n_misses, n_stored, n_evicted;
+	u64 hashed_bytes, hash_ns;
+	u64 hit_bytes, stored_bytes, evicted_bytes, size; /* size is as of closing */
+} TokenCache;
+
+/* Opens (creating it if needed) the cache in `dir` for lexer output with
+ * `fingerprint`. Returns false, after warning about it, if the directory
+ * can't be used; lexing then goes on without a cache.
+ */
+bool token_cache_open(TokenCache *cache, const char *dir, u64 max_size, u64 fingerprint);
+/* Evicts entries down to the size limit. The counters stay readable. */
+void token_cache_close(TokenCache *cache);
+
+/* The key of `source` (a `SourceFile`'s contents). */
+u64 token_cache_hash(TokenCache *cache, struct str_buf source);
+/* Looks up the entry for `source` with hash `key`. */
+bool token_cache_get(TokenCache *cache, u64 key, struct str_buf source, TokenCacheEntry *out);
+void token_cache_release(TokenCacheEntry *entry);
+/* Stores `len` bytes at `data` as the entry for `source`. Failing to is
+ * only counted as not storing it.
+ */
+void token_cache_put(TokenCache *cache, u64 key, struct str_buf source, s32 status,
+		u64 comment_bytes, const void *data, size_t len);
+
+/* Prints the hit rate and traffic of `cache` for --cache-stats. */
+void token_cache_print_stats(FILE *stream, const TokenCache *cache);
+
+#endif /* TOKEN_CACHE_H */
@@ -0,0 +1,255 @@
+#include "token_file.h"
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "lexer.h"
+#include "token_table.h"
+#include "types.h"
+#include "util.h"
+
+#define ALIGN8(n) (((n) + 7) & ~(u64) 7)
+#define RECORD_BATCH_SIZE 4096
+
+static bool write_padding(FILE *out, u64 *pos, u64 to)
+{
+	static const char zeroes[8] = {0};
+	bool ok = (fwrite(zeroes, 1, to - *pos, out) == to - *pos);
+	*pos = to;
+	return ok;
+}
+
+static bool write_records(FILE *out, const TokenTable *table)
+{
+	TokenRecord batch[RECORD_BATCH_SIZE];
+	for (size_t start = 0; start < table->len; start += RECORD_BATCH_SIZE)
+	{
+		size_t n = MIN(RECORD_BATCH_SIZE, table->len - start);
+		for (size_t i = 0; i < n; ++i)
+		{
+			u8 kind = table->kinds[start + i];
+			batch[i] = (TokenRecord) {
+				.offset = table->offsets[start + i],
+				.length = table->lengths[start + i],
+				.type = token_kind_type(kind),
+				.subtype = token_kind_subtype(kind),
+			};
+		}
+		if (fwrite(batch, sizeof(TokenRecord), n, out) != n)
+			return false;
+	}
+	return true;
+}
+
+bool token_file_write(FILE *out, const TokenFileInput *files, u32 n_files, bool embed_source)
+{
+	TokenFileEntry *entries = calloc(MAX(n_files, 1), sizeof(TokenFileEntry));
+	if (entries == NULL)
+	{
+		flogf(LOG_ERR, stderr, "failed to allocate token file table\n");
+		exit(3);
+	}
+
+	// lay everything out first, so the file can be written front to back
+	u64 pos = ALIGN8(sizeof(TokenFileHeader)) + (u64) n_files * sizeof(TokenFileEntry);
+	for (u32 i = 0; i < n_files; ++i)
+	{
+		const TokenTable *table = files[i].tokens;
+		entries[i].name_offset = pos;
+		pos = ALIGN8(pos + strlen(files[i].name) + 1);
+		if (embed_source)
+		{
+			entries[i].source_offset = pos;
+			pos = ALIGN8(pos + table->source.len);
+		}
+		entries[i].source_len = table->source.len;
+		entries[i].tokens_offset = pos;
+		entries[i].n_tokens = table->len;
+		entries[i].status = files[i].status;
+		pos += (u64) table->len * sizeof(TokenRecord);
+	}
+	TokenFileHeader header = {
+		.magic = TOKEN_FILE_MAGIC,
+		.version = TOKEN_FILE_VERSION,
+		.byte_order = TOKEN_FILE_BYTE_ORDER,
+		.flags = embed_source ? TOKEN_FILE_HAS_SOURCE : 0,
+		.n_files = n_files,
+		.files_offset = ALIGN8(sizeof(TokenFileHeader)),
+		.size = pos,
+	};
+
+	pos = 0;
+	bool ok = (fwrite(&header, sizeof(header), 1, out) == 1);
+	pos += sizeof(header);
+	ok = ok && write_padding(out, &pos, header.files_offset);
+	ok = ok && fwrite(entries, sizeof(TokenFileEntry), n_files, out) == n_files;
+	pos += (u64) n_files * sizeof(TokenFileEntry);
+	for (u32 i = 0; ok && i < n_files; ++i)
+	{
+		const TokenTable *table = files[i].tokens;
+		size_t name_len = strlen(files[i].name) + 1;
+		ok = fwrite(files[i].name, 1, name_len, out) == name_len;
+		pos += name_len;
+		if (embed_source)
+		{
+			ok = ok && write_padding(out, &pos, entries[i].source_offset);
+			ok = ok && fwrite(table->source.buf, 1, table->source.len, out) == table->source.len;
+			pos += table->source.len;
+		}
+		ok = ok && write_padding(out, &pos, entries[i].tokens_offset);
+		ok = ok && write_records(out, table);
+		pos += (u64) table->len * sizeof(TokenRecord);
+	}
+	free(entries);
+	return ok && fflush(out) == 0;
+}
+
+static bool token_file_invalid(const char *reason)
+{
+	flogf(LOG_ERR, stderr, "invalid token file: %s\n", reason);
+	return false;
+}
+
+static bool in_file(const TokenFile *tf, u64 offset, u64 len)
+{
+	return offset <= tf->size && len <= tf->size - offset;
+}
+
+bool token_file_from_buf(TokenFile *tf, const void *data, size_t size)
+{
+	*tf = (TokenFile) { .data = data, .size = size };
+	const TokenFileHeader *header = data;
+	if (size < sizeof(TokenFileHeader) || memcmp(header->magic, TOKEN_FILE_MAGIC, sizeof(header->magic)) != 0)
+		return token_file_invalid("bad magic number");
+	if (header->byte_order != TOKEN_FILE_BYTE_ORDER)
+		return token_file_invalid("written with a different byte order");
+	if (header->version != TOKEN_FILE_VERSION)
+		return token_file_invalid("unsupported version");
+	if (header->size != size)
+		return token_file_invalid("truncated");
+	if (header->files_offset % 8 != 0
+	 || !in_file(tf, header->files_offset, (u64) header->n_files * sizeof(TokenFileEntry)))
+		return token_file_invalid("file table out of bounds");
+	tf->header = header;
+	tf->files = (const TokenFileEntry *) (tf->data + header->files_offset);
+
+	for (u32 i = 0; i < header->n_files; ++i)
+	{
+		const TokenFileEntry *entry = &tf->files[i];
+		if (!in_file(tf, entry->name_offset, 0)
+		 || memchr(tf->data + entry->name_offset, '\0', size - entry->name_offset) == NULL)
+			return token_file_invalid("file name out of bounds");
+		if ((header->flags & TOKEN_FILE_HAS_SOURCE) && !in_file(tf, entry->source_offset, entry->source_len))
+			return token_file_invalid("source out of bounds");
+		if (entry->tokens_offset % 8 != 0 || entry->n_tokens > size / sizeof(TokenRecord)
+		 || !in_file(tf, entry->tokens_offset, entry->n_tokens * sizeof(TokenRecord)))
+			return token_file_invalid("tokens out of bounds");
+		// the records themselves are only checked when a token is rebuilt, so
+		// opening a file doesn't cost a pass over all of its tokens
+	}
+	return true;
+}
+
+bool token_file_open(TokenFile *tf, const char *path)
+{
+	*tf = (TokenFile) {0};
+	s32 fd = open(path, O_RDONLY);
+	if (fd < 0)
+	{
+		flogf(LOG_ERR, stderr, "failed to open file '%s'\n", path);
+		return false;
+	}
+	struct stat st;
+	if (fstat(fd, &st) < 0 || st.st_size == 0)
+	{
+		close(fd);
+		return token_file_invalid("empty");
+	}
+	void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED)
+	{
+		flogf(LOG_ERR, stderr, "failed to map file '%s'\n", path);
+		return false;
+	}
+	if (!token_file_from_buf(tf, map, st.st_size))
+	{
+		munmap(map, st.st_size);
+		*tf = (TokenFile) {0};
+		return false;
+	}
+	tf->map_size = st.st_size;
+	return true;
+}
+
+void token_file_close(TokenFile *tf)
+{
+	if (tf->map_size != 0)
+		munmap((void *) tf->data, tf->map_size);
+	*tf = (TokenFile) {0};
+}
+
+const char *token_file_name(const TokenFile *tf, u32 file)
+{
+	return (const char *) (tf->data + tf->files[file].name_offset);
+}
+
+const TokenRecord *token_file_tokens(const TokenFile *tf, u32 file, size_t *n_tokens)
+{
+	*n_tokens = tf->files[file].n_tokens;
+	return (const TokenRecord *) (tf->data + tf->files[file].tokens_offset);
+}
+
+struct str_buf token_file_source(const TokenFile *tf, u32 file)
+{
+	const TokenFileEntry *entry = &tf->files[file];
+	if (!(tf->header->flags & TOKEN_FILE_HAS_SOURCE))
+		return strbuflit(NULL, 0, (char *) token_file_name(tf, file));
+	return (struct str_buf) { (char *) tf->data + entry->source_offset,
+		(char *) token_file_name(tf, file), entry->source_len, entry->source_len };
+}
+
+/* Whether `type` and `subtype` are a pair a token table can hold, which is
+ * where every written record comes from.
+ */
+static bool record_kind_valid(const TokenRecord *record)
+{
+	if (record->type > FileEndToken)
+		return false;
+	u8 kind = token_kind_pack(record->type, record->subtype);
+	return token_kind_type(kind) == record->type && token_kind_subtype(kind) == record->subtype;
+}
+
+Token token_file_token(const TokenFile *tf, u32 file, size_t i)
+{
+	size_t n_tokens;
+	const TokenRecord *record = &token_file_tokens(tf, file, &n_tokens)[i];
+	struct str_buf source = token_file_source(tf, file);
+	if (!record_kind_valid(record))
+		return (Token) { MiscToken, ERROR_TOKEN, strbuflit(NULL, record->length, source.container_filename) };
+	char *value = NULL;
+	if (source.buf != NULL && (u64) record->offset + record->length <= source.len)
+		value = source.buf + record->offset;
+	return (Token) { record->type, record->subtype,
+		strbuflit(value, record->length, source.container_filename) };
+}
+
+size_t token_file_find(const TokenFile *tf, u32 file, u32 offset)
+{
+	size_t n_tokens;
+	const TokenRecord *records = token_file_tokens(tf, file, &n_tokens);
+	size_t lo = 0, hi = n_tokens;
+	while (lo < hi)
+	{
+		size_t mid = lo + (hi - lo) / 2;
+		if ((u64) records[mid].offset + records[mid].length <= offset)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
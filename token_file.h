@@ -0,0 +1,112 @@
+#ifndef TOKEN_FILE_H
+#define TOKEN_FILE_H
+
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "lexer.h"
+#include "token_table.h"
+#include "types.h"
+#include "util.h"
+
+/* The binary token stream written by `lexer --format=bin`, laid out so that
+ * a reader can map the file and index it in place:
+ *
+ *   TokenFileHeader
+ *   TokenFileEntry[n_files]
+ *   per file: its name (NUL-terminated), its source if embedded, and its
+ *             TokenRecords in source order, each part 8-byte aligned
+ *
+ * Every offset is from the start of the file. Fields are in the writer's
+ * byte order, which `byte_order` records.
+ */
+
+#define TOKEN_FILE_MAGIC "ATPTOKS" /* with its NUL, fills `magic` */
+#define TOKEN_FILE_VERSION 1
+#define TOKEN_FILE_BYTE_ORDER 0x01020304
+
+/* TokenFileHeader.flags */
+enum {
+	TOKEN_FILE_HAS_SOURCE = (1<<0), /* every file's source is embedded */
+};
+
+typedef struct {
+	char magic[8];
+	u32 version;
+	u32 byte_order;
+	u32 flags;
+	u32 n_files;
+	u64 files_offset; /* of the TokenFileEntry table */
+	u64 size; /* of the whole token file */
+} TokenFileHeader;
+
+typedef struct {
+	u64 name_offset;
+	u64 source_offset; /* 0 without TOKEN_FILE_HAS_SOURCE */
+	u64 source_len; /* as lexed, including its terminating NUL */
+	u64 tokens_offset;
+	u64 n_tokens;
+	s32 status; /* the lexer's exit code for this file, e.g. 1 if it stopped at an error */
+	u32 reserved;
+} TokenFileEntry;
+
+typedef struct {
+	u32 offset; /* into the source */
+	u32 length;
+	u8 type; /* TokenType */
+	u8 subtype; /* TokenSubType */
+	u16 reserved;
+} TokenRecord;
+
+/* one lexed file to write */
+typedef struct {
+	const char *name;
+	const TokenTable *tokens;
+	s32 status;
+} TokenFileInput;
+
+/* Writes `n_files` token tables to `out`, with their sources if
+ * `embed_source`. Returns false if writing failed.
+ */
+bool token_file_write(FILE *out, const TokenFileInput *files, u32 n_files, bool embed_source);
+
+/* A token file being read. */
+typedef struct {
+	const u8 *data;
+	size_t size;
+	size_t map_size; /* 0 if `data` belongs to the caller */
+	const TokenFileHeader *header;
+	const TokenFileEntry *files;
+} TokenFile;
+
+/* Maps the token file at `path` read-only and checks that its header and
+ * file table are well-formed, which doesn't depend on the number of tokens.
+ * Returns false, after reporting why, if it can't be read or isn't valid.
+ */
+bool token_file_open(TokenFile *tf, const char *path);
+/* Same for a token file that is already in memory, suitably aligned; `data`
+ * isn't copied and must outlive `tf`.
+ */
+bool token_file_from_buf(TokenFile *tf, const void *data, size_t size);
+void token_file_close(TokenFile *tf);
+
+const char *token_file_name(const TokenFile *tf, u32 file);
+/* the records of `file`, indexable directly; their offsets and lengths
+ * aren't checked against the source
+ */
+const TokenRecord *token_file_tokens(const TokenFile *tf, u32 file, size_t *n_tokens);
+/* the embedded source of `file`, or a NULL buffer if there is none */
+struct str_buf token_file_source(const TokenFile *tf, u32 file);
+/* Rebuilds token `i` of `file`. Its value points into the embedded source,
+ * or is NULL (with the right length) if there is none or the record lies
+ * outside of it. A record whose type and subtype no lexer produces, as in
+ * a damaged file, is rebuilt as a MiscToken with ERROR_TOKEN and a NULL
+ * value.
+ */
+Token token_file_token(const TokenFile *tf, u32 file, size_t i);
+/* Returns the index of the first token of `file` that ends after source
+ * offset `offset` (the one containing it, if any), or the number of tokens.
+ */
+size_t token_file_find(const TokenFile *tf, u32 file, u32 offset);
+
+#endif /* TOKEN_FILE_H */
@@ -0,0 +1,192 @@
+#include "token_table.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "types.h"
+#include "util.h"
+#include "arena.h"
+#include "lexer.h"
+
+#define KIND_SUBTYPE_BITS 3
+#define N_KIND_TYPES 32
+
+/* every TokenType, in the order of its 5-bit index */
+static const TokenType kind_types[N_KIND_TYPES] = {
+	MiscToken, IdentifierToken,
+	StartStringToken, WithinStringToken, EscapeCodeStartToken, EscapeCodeToken, EndStringToken,
+	StartCharToken, WithinCharToken, EndCharToken,
+	VarTypeInferInitToken, OperatorToken,
+	StartBlockToken, EndBlockToken, StartParenToken, EndParenToken, StartBracketToken, EndBracketToken,
+	EndStatementToken, ItemSeparatorToken, VariableArgumentIndicatorToken, ReturnTypeIndicatorToken,
+	IntegerLiteralToken, FileEndToken,
+	StringLiteralToken, CharLiteralToken,
+};
+
+/* the inverse of kind_types */
+static const u8 kind_type_indices[FileEndToken+1] = {
+	[MiscToken] = 0, [IdentifierToken] = 1,
+	[StartStringToken] = 2, [WithinStringToken] = 3, [EscapeCodeStartToken] = 4,
+	[EscapeCodeToken] = 5, [EndStringToken] = 6,
+	[StartCharToken] = 7, [WithinCharToken] = 8, [EndCharToken] = 9,
+	[VarTypeInferInitToken] = 10, [OperatorToken] = 11,
+	[StartBlockToken] = 12, [EndBlockToken] = 13, [StartParenToken] = 14,
+	[EndParenToken] = 15, [StartBracketToken] = 16, [EndBracketToken] = 17,
+	[EndStatementToken] = 18, [ItemSeparatorToken] = 19,
+	[VariableArgumentIndicatorToken] = 20, [ReturnTypeIndicatorToken] = 21,
+	[IntegerLiteralToken] = 22, [FileEndToken] = 23,
+	[StringLiteralToken] = 24, [CharLiteralToken] = 25,
+};
+
+static u8 kind_type_index(TokenType type)
+{
+	return (type <= FileEndToken) ? kind_type_indices[type] : 0;
+}
+
+static u8 kind_subtype_index(TokenSubType subtype)
+{
+	switch (subtype) {
+	case ERROR_TOKEN:       return 0;
+	case GROUPING_TOKEN:    return 1;
+	case NOT_IDENTIFIER:    return 2;
+	case NORMAL_IDENTIFIER: return 3;
+	case FUNC_KEYWORD:
+	case TYPE_KEYWORD:
+	case RETURN_KEYWORD:
+	case RESERVED_KEYWORD:
+		return 4 + (subtype - FUNC_KEYWORD);
+	case DEC_INT_LITERAL:
+	case HEX_INT_LITERAL:
+	case OCT_INT_LITERAL:
+	case BIN_INT_LITERAL:
+		return 4 + (subtype - DEC_INT_LITERAL);
+	}
+	return 0;
+}
+
+u8 token_kind_pack(TokenType type, TokenSubType subtype)
+{
+	return (kind_type_index(type) << KIND_SUBTYPE_BITS) | kind_subtype_index(subtype);
+}
+
+TokenType token_kind_type(u8 kind)
+{
+	return kind_types[kind >> KIND_SUBTYPE_BITS];
+}
+
+TokenSubType token_kind_subtype(u8 kind)
+{
+	u8 index = kind & ((1 << KIND_SUBTYPE_BITS) - 1);
+	if (index < 4)
+		return (TokenSubType) index;
+	if (token_kind_type(kind) == IntegerLiteralToken)
+		return (TokenSubType) (DEC_INT_LITERAL + index - 4);
+	return (TokenSubType) (FUNC_KEYWORD + index - 4);
+}
+
+void token_table_init(TokenTable *table, struct str_buf source, char *filename)
+{
+	if (source.len > UINT32_MAX)
+	{
+		flogf(LOG_ERR, stderr, "'%s' is too large for a token table (%zu bytes)\n",
+				filename, source.len);
+		exit(7);
+	}
+	*table = (TokenTable) {0};
+	table->source = source;
+	table->source.container_filename = filename;
+}
+
+void token_table_free(TokenTable *table)
+{
+	if (table->arena == NULL)
+	{
+		free(table->offsets);
+		free(table->lengths);
+		free(table->kinds);
+	}
+	*table = (TokenTable) {0};
+}
+
+static void token_table_grow(TokenTable *table)
+{
+	size_t new_capacity = MAX(table->capacity * 2, 1024);
+	if (table->arena != NULL)
+	{
+		table->offsets = arena_realloc(table->arena, table->offsets,
+				table->capacity * sizeof(u32), new_capacity * sizeof(u32));
+		table->lengths = arena_realloc(table->arena, table->lengths,
+				table->capacity * sizeof(u32), new_capacity * sizeof(u32));
+		table->kinds = arena_realloc(table->arena, table->kinds, table->capacity, new_capacity);
+		table->capacity = new_capacity;
+		return;
+	}
+	u32 *offsets = realloc(table->offsets, new_capacity * sizeof(u32));
+	u32 *lengths = realloc(table->lengths, new_capacity * sizeof(u32));
+	u8 *kinds = realloc(table->kinds, new_capacity);
+	if (offsets == NULL || lengths == NULL || kinds == NULL)
+	{
+		flogf(LOG_ERR, stderr, "failed to reallocate token table with capacity %zu\n", new_capacity);
+		exit(4);
+	}
+	table->offsets = offsets;
+	table->lengths = lengths;
+	table->kinds = kinds;
+	table->capacity = new_capacity;
+}
+
+void token_table_push(TokenTable *table, Token token)
+{
+	if (table->len == table->capacity)
+		token_table_grow(table);
+
+	table->offsets[table->len] = token.value.buf - table->source.buf;
+	table->lengths[table->len] = token.value.len;
+	table->kinds[table->len] = token_kind_pack(token.type, token.subtype);
+	table->len++;
+}
+
+void token_table_append(TokenTable *dst, const TokenTable *src, size_t start, size_t end, s64 shift)
+{
+	// an empty table may have no columns to copy into yet
+	if (start == end)
+		return;
+	while (dst->capacity - dst->len < end - start)
+		token_table_grow(dst);
+	for (size_t i = start; i < end; ++i)
+		dst->offsets[dst->len + i - start] = src->offsets[i] + shift;
+	memcpy(dst->lengths + dst->len, src->lengths + start, (end - start) * sizeof(u32));
+	memcpy(dst->kinds + dst->len, src->kinds + start, end - start);
+	dst->len += end - start;
+}
+
+struct str_buf token_table_value(const TokenTable *table, size_t i)
+{
+	char *start = table->source.buf + table->offsets[i];
+	return (struct str_buf) {
+		start,
+		table->source.container_filename,
+		table->lengths[i],
+		(table->source.buf + table->source.len) - start,
+	};
+}
+
+Token token_table_get(const TokenTable *table, size_t i)
+{
+	return (Token) {
+		token_kind_type(table->kinds[i]),
+		token_kind_subtype(table->kinds[i]),
+		token_table_value(table, i),
+	};
+}
+
+size_t lexer_fill_table(Lexer *lx, TokenTable *table)
+{
+	Token batch[256];
+	size_t n_before = table->len;
+	size_t n;
+	while ((n = lexer_next_batch(lx, batch, sizeof(batch)/sizeof(*batch))) > 0)
+		for (size_t i = 0; i < n; ++i)
+			token_table_push(table, batch[i]);
+	return table->len - n_before;
+}
@@ -0,0 +1,50 @@
+#ifndef TOKEN_TABLE_H
+#define TOKEN_TABLE_H
+
+#include "arena.h"
+#include "lexer.h"
+#include "types.h"
+#include "util.h"
+
+/* A compact, structure-of-arrays alternative to an array of `Token`s.
+ * Each token costs 9 bytes (offset, length, kind) instead of a full `Token`,
+ * and the source buffer/filename are stored once for the whole table.
+ * Offsets are relative to `source.buf`, so sources must be smaller than 4 GiB.
+ */
+typedef struct {
+	struct str_buf source; /* container_filename is the filename for every token */
+	u32 *offsets;
+	u32 *lengths;
+	u8 *kinds; /* packed type/subtype, see `token_kind_pack` */
+	size_t len;
+	size_t capacity;
+	Arena *arena; /* owns the arrays if set (right after token_table_init) */
+} TokenTable;
+
+/* Packs a type/subtype pair into one byte: the upper 5 bits index the token
+ * type, the lower 3 the subtype (keyword subtypes only occur on identifiers and
+ * integer literal subtypes only on integer literals, so they share codes).
+ */
+u8 token_kind_pack(TokenType type, TokenSubType subtype);
+TokenType token_kind_type(u8 kind);
+TokenSubType token_kind_subtype(u8 kind);
+
+void token_table_init(TokenTable *table, struct str_buf source, char *filename);
+void token_table_free(TokenTable *table);
+void token_table_push(TokenTable *table, Token token);
+/* Appends tokens [start, end) of `src` to `dst` with their offsets moved by
+ * `shift`, e.g. to reuse them in a source that had bytes inserted before them.
+ */
+void token_table_append(TokenTable *dst, const TokenTable *src, size_t start, size_t end, s64 shift);
+
+/* Rebuild a view of token `i` pointing into the table's source buffer. */
+struct str_buf token_table_value(const TokenTable *table, size_t i);
+Token token_table_get(const TokenTable *table, size_t i);
+
+/* Lexes the rest of `lx`'s stream into `table` (initialized over the same
+ * source) and returns the number of tokens appended. Errors are left in
+ * `lx->errflags`.
+ */
+size_t lexer_fill_table(Lexer *lx, TokenTable *table);
+
+#endif /* TOKEN_TABLE_H */
@@ -0,0 +1,145 @@
+#include "token_writer.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "arena.h"
+#include "lexer.h"
+#include "types.h"
+#include "util.h"
+
+#define TOKEN_PREFIX "{ type: 0x"
+#define SUBTYPE_PREFIX ", subtype: 0x"
+#define VALUE_PREFIX ", value: \""
+#define TOKEN_SUFFIX "\" }\n"
+#define ESCAPED_LEN 4 /* "<0a>" */
+/* the longest a token can get besides its value: two 8-digit numbers */
+#define MAX_TOKEN_OVERHEAD (sizeof(TOKEN_PREFIX SUBTYPE_PREFIX VALUE_PREFIX TOKEN_SUFFIX) + 16)
+
+/* the bytes iscntrl() is true for in the C locale */
+static const u8 needs_escape[256] = {
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+	[0x7F] = 1,
+};
+
+static const char hex_upper[16] = "0123456789ABCDEF";
+static const char hex_lower[16] = "0123456789abcdef";
+
+#define PUT_LIT(p, lit) (memcpy((p), (lit), sizeof(lit) - 1), (p) += sizeof(lit) - 1)
+
+/* like "%02X" */
+static char *put_hex(char *p, u32 n)
+{
+	char digits[8];
+	size_t n_digits = 0;
+	do {
+		digits[n_digits++] = hex_upper[n & 0xF];
+		n >>= 4;
+	} while (n != 0);
+	if (n_digits < 2)
+		*p++ = '0';
+	while (n_digits > 0)
+		*p++ = digits[--n_digits];
+	return p;
+}
+
+void token_writer_open(TokenWriter *w, FILE *stream, Arena *arena)
+{
+	*w = (TokenWriter) { .stream = stream, .capacity = TOKEN_WRITER_BUF_SIZE, .arena = arena };
+	// anything already printed to the stream has to come out first
+	fflush(stream);
+	w->fd = fileno(stream);
+	if (arena != NULL)
+	{
+		w->buf = arena_alloc(arena, w->capacity);
+		return;
+	}
+	w->buf = malloc(w->capacity);
+	if (w->buf == NULL)
+	{
+		flogf(LOG_ERR, stderr, "failed to allocate output buffer\n");
+		exit(3);
+	}
+}
+
+bool token_writer_flush(TokenWriter *w)
+{
+	if (w->fd < 0)
+	{
+		w->failed |= (fwrite(w->buf, 1, w->len, w->stream) != w->len);
+		w->len = 0;
+		return !w->failed;
+	}
+	char *p = w->buf;
+	while (!w->failed && p < w->buf + w->len)
+	{
+		ssize_t n_written = write(w->fd, p, w->buf + w->len - p);
+		if (n_written < 0 && errno != EINTR)
+			w->failed = true;
+		else if (n_written > 0)
+			p += n_written;
+	}
+	w->len = 0;
+	return !w->failed;
+}
+
+void token_writer_put(TokenWriter *w, Token token)
+{
+	size_t max_len = MAX_TOKEN_OVERHEAD + token.value.len * ESCAPED_LEN;
+	if (w->len + max_len > w->capacity)
+	{
+		token_writer_flush(w);
+		if (max_len > w->capacity)
+		{
+			// only for a huge (coalesced) literal
+			char *new_buf = (w->arena != NULL) ? arena_alloc(w->arena, max_len) : realloc(w->buf, max_len);
+			if (new_buf == NULL)
+			{
+				flogf(LOG_ERR, stderr, "failed to reallocate output buffer\n");
+				exit(4);
+			}
+			w->buf = new_buf;
+			w->capacity = max_len;
+		}
+	}
+
+	char *p = w->buf + w->len;
+	PUT_LIT(p, TOKEN_PREFIX);
+	p = put_hex(p, token.type);
+	PUT_LIT(p, SUBTYPE_PREFIX);
+	p = put_hex(p, token.subtype);
+	PUT_LIT(p, VALUE_PREFIX);
+	const u8 *src = (const u8 *) token.value.buf, *src_end = src + token.value.len;
+	while (src < src_end)
+	{
+		// copy the run up to the next byte that needs escaping in one go
+		const u8 *run_end = src;
+		while (run_end < src_end && !needs_escape[*run_end])
+			run_end++;
+		memcpy(p, src, run_end - src);
+		p += run_end - src;
+		src = run_end;
+		if (src == src_end)
+			break;
+		*p++ = '<';
+		*p++ = hex_lower[*src >> 4];
+		*p++ = hex_lower[*src & 0xF];
+		*p++ = '>';
+		src++;
+	}
+	PUT_LIT(p, TOKEN_SUFFIX);
+	w->len = p - w->buf;
+	w->n_tokens++;
+}
+
+bool token_writer_close(TokenWriter *w)
+{
+	bool ok = token_writer_flush(w);
+	if (w->arena == NULL)
+		free(w->buf);
+	w->buf = NULL;
+	return ok;
+}
@@ -0,0 +1,40 @@
+#ifndef TOKEN_WRITER_H
+#define TOKEN_WRITER_H
+
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "arena.h"
+#include "lexer.h"
+#include "types.h"
+
+/* Prints tokens in the lexer's text format,
+ *   { type: 0x04, subtype: 0x03, value: "main" }
+ * with control characters in values escaped as "<0a>" like dbg_escape_str.
+ * Tokens are formatted straight into one reusable buffer, which is written
+ * out with a single write(2) whenever it fills up (or with fwrite, if the
+ * stream has no file descriptor, e.g. a memstream).
+ */
+
+#define TOKEN_WRITER_BUF_SIZE (256 * 1024)
+
+typedef struct {
+	FILE *stream;
+	s32 fd; /* -1 to fwrite to `stream` instead */
+	char *buf;
+	size_t len;
+	size_t capacity;
+	bool failed; /* a write failed; everything after it is dropped */
+	size_t n_tokens; /* put so far */
+	Arena *arena; /* owns `buf`, or NULL if it's malloc'd */
+} TokenWriter;
+
+/* `arena`, if not NULL, provides the buffer. */
+void token_writer_open(TokenWriter *w, FILE *stream, Arena *arena);
+void token_writer_put(TokenWriter *w, Token token);
+/* Writes out everything buffered so far. Returns false if any write failed. */
+bool token_writer_flush(TokenWriter *w);
+/* Flushes and frees the buffer (but doesn't close the stream). */
+bool token_writer_close(TokenWriter *w);
+
+#endif /* TOKEN_WRITER_H */
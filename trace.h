@@ -0,0 +1,37 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdio.h>
+
+#include "args.h"
+#include "util.h"
+
+/* Debug output for hot paths, in two levels:
+ *
+ * `trace(...)` is for per-token detail. It compiles to nothing unless the
+ * build defines LEXER_TRACE (see `make build/lexer_trace`), in which case it
+ * prints like flogf(LOG_DEBUG, stdout, ...) when -d is given. Its arguments
+ * are still type-checked either way.
+ *
+ * `debug_event(...)` is for cheap, infrequent events, e.g. a lexer being set
+ * up. It's always compiled in, but checks for -d before evaluating its
+ * arguments.
+ */
+
+#define debug_event(...) do { \
+	if (FLAG_SET(DEBUG)) \
+		flogf(LOG_DEBUG, stdout, __VA_ARGS__); \
+} while (0)
+
+#ifdef LEXER_TRACE
+#define TRACING 1
+#else
+#define TRACING 0
+#endif
+
+#define trace(...) do { \
+	if (TRACING && FLAG_SET(DEBUG)) \
+		flogf(LOG_DEBUG, stdout, __VA_ARGS__); \
+} while (0)
+
+#endif /* TRACE_H */
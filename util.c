@@ -7,7 +7,12 @@
 #include <string.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
+#include "arena.h"
 #include "types.h"
 #ifndef BARE_UTIL_FLAG
 #include "args.h"
@@ -132,6 +137,173 @@ strbuf read_file_to_string(const char *file_name)
 	return ret_buf;
 }
 
+/* Reads all of `fd` into a malloc'd buffer with room for the padding.
+ * `size_hint` is the expected size, e.g. from `fstat` (0 if unknown).
+ */
+static strbuf read_fd_padded(s32 fd, const char *file_name, size_t size_hint)
+{
+	size_t buf_size = size_hint + 1 + SOURCE_PADDING;
+	strbuf ret_buf = {0};
+	ret_buf.buf = malloc(buf_size);
+	if (ret_buf.buf == NULL)
+	{
+		flogf(LOG_ERR, stderr, "failed to allocate a buffer of size %zu for '%s'\n", buf_size, file_name);
+		exit(3);
+	}
+
+	ssize_t cur_chunk_read;
+	for (;;)
+	{
+		if (ret_buf.len + 1 + SOURCE_PADDING >= buf_size)
+		{
+			if (size_hint != 0)
+				break;
+			// the size isn't known up front, e.g. for a pipe
+			buf_size = MAX(buf_size * 2, 4096);
+			char *temp_buf = realloc(ret_buf.buf, buf_size);
+			if (temp_buf == NULL)
+			{
+				free(ret_buf.buf);
+				flogf(LOG_ERR, stderr, "failed to reallocate buffer with size %zu\n", buf_size);
+				exit(4);
+			}
+			ret_buf.buf = temp_buf;
+		}
+		cur_chunk_read = read(fd, ret_buf.buf + ret_buf.len, buf_size - ret_buf.len - 1 - SOURCE_PADDING);
+		if (cur_chunk_read < 0 && errno == EINTR)
+			continue;
+		if (cur_chunk_read < 0)
+		{
+			flogf(LOG_ERR, stderr, "failed to read file '%s': %s\n", file_name, strerror(errno));
+			exit(5);
+		}
+		if (cur_chunk_read == 0)
+			break;
+		ret_buf.len += cur_chunk_read;
+	}
+
+	memset(ret_buf.buf + ret_buf.len, '\0', 1 + SOURCE_PADDING);
+	ret_buf.len++;
+	ret_buf.capacity = buf_size;
+	return ret_buf;
+}
+
+SourceFile load_source_file(const char *file_name)
+{
+	s32 fd = open(file_name, O_RDONLY);
+	if (fd < 0)
+	{
+		flogf(LOG_ERR, stderr, "failed to open file '%s'\n", file_name);
+		exit(2);
+	}
+
+	SourceFile ret = {0};
+	struct stat st;
+	if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode) || st.st_size == 0)
+	{
+		ret.contents = read_fd_padded(fd, file_name, 0);
+		close(fd);
+		return ret;
+	}
+
+	size_t file_size = st.st_size;
+	size_t page_size = sysconf(_SC_PAGESIZE);
+	// the bytes after the end of the file up to the end of its last page
+	// read as zeroes; if there are too few of them, the file is mapped over
+	// the start of a larger anonymous (zeroed) mapping
+	size_t map_size = (file_size + 1 + SOURCE_PADDING + page_size - 1) / page_size * page_size;
+	char *map = mmap(NULL, map_size, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (map == MAP_FAILED
+	 || mmap(map, file_size, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED)
+	{
+		// e.g. a file system that can't be mapped; read it in one go instead
+		if (map != MAP_FAILED)
+			munmap(map, map_size);
+		ret.contents = read_fd_padded(fd, file_name, file_size);
+		close(fd);
+		return ret;
+	}
+	close(fd);
+
+	madvise(map, file_size, MADV_SEQUENTIAL);
+#ifdef MADV_HUGEPAGE
+	if (file_size >= (2 << 20))
+		madvise(map, file_size, MADV_HUGEPAGE);
+#endif
+
+	ret.contents = (strbuf) { map, NULL, file_size + 1, map_size };
+	ret.map_size = map_size;
+	return ret;
+}
+
+void unload_source_file(SourceFile *file)
+{
+	if (file->map_size != 0)
+		munmap(file->contents.buf, file->map_size);
+	else
+		free(file->contents.buf);
+	*file = (SourceFile) {0};
+}
+
+#define HASH_P1 0x9E3779B185EBCA87ULL
+#define HASH_P2 0xC2B2AE3D27D4EB4FULL
+#define HASH_P3 0x165667B19E3779F9ULL
+#define HASH_P4 0x85EBCA77C2B2AE63ULL
+#define HASH_P5 0x27D4EB2F165667C5ULL
+
+static u64 rotl64(u64 x, u32 r)
+{
+	return (x << r) | (x >> (64 - r));
+}
+
+static u64 load64(const u8 *p)
+{
+	u64 v;
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+static u64 hash_round(u64 acc, u64 input)
+{
+	return rotl64(acc + input * HASH_P2, 31) * HASH_P1;
+}
+
+static u64 hash_merge(u64 acc, u64 lane)
+{
+	return (acc ^ hash_round(0, lane)) * HASH_P1 + HASH_P4;
+}
+
+u64 hash_bytes(const void *buf, size_t len, u64 seed)
+{
+	const u8 *p = buf, *end = p + len;
+	u64 h;
+	if (len >= 32)
+	{
+		// four independent lanes, so the multiplies can overlap
+		u64 v1 = seed + HASH_P1 + HASH_P2, v2 = seed + HASH_P2, v3 = seed, v4 = seed - HASH_P1;
+		for (; end - p >= 32; p += 32)
+		{
+			v1 = hash_round(v1, load64(p));
+			v2 = hash_round(v2, load64(p + 8));
+			v3 = hash_round(v3, load64(p + 16));
+			v4 = hash_round(v4, load64(p + 24));
+		}
+		h = rotl64(v1, 1) + rotl64(v2, 7) + rotl64(v3, 12) + rotl64(v4, 18);
+		h = hash_merge(hash_merge(hash_merge(hash_merge(h, v1), v2), v3), v4);
+	} else
+		h = seed + HASH_P5;
+	h += len;
+	for (; end - p >= 8; p += 8)
+		h = rotl64(h ^ hash_round(0, load64(p)), 27) * HASH_P1 + HASH_P4;
+	for (; p < end; ++p)
+		h = rotl64(h ^ (*p * HASH_P5), 11) * HASH_P1;
+	h ^= h >> 33;
+	h *= HASH_P2;
+	h ^= h >> 29;
+	h *= HASH_P3;
+	return h ^ (h >> 32);
+}
+
 s32 write_buf_to_file(strbuf buf, const char *dst_path)
 {
 	// check if the file exists
@@ -172,45 +344,60 @@ s32 write_buf_to_file(strbuf buf, const char *dst_path)
 
 extern u8 tab_width;
 
-void debug_print_pos(FILE *stream, struct str_buf substr, char *container, size_t line_num, 
-		u8 highlight_color, u8 caret_color, LOG_TYPE log_type, const char *msg_fmt, ...)
-{
-		if (log_type == LOG_DEBUG && !FLAG_SET(DEBUG))
-			return;
+// scratch space for one diagnostic, per thread like temp_arena
+static _Thread_local Arena diag_arena;
 
-		char *prev_newline = substr.buf;
-		while (prev_newline > container && *(prev_newline-1) != '\n')
-			prev_newline--;
+/* Bytes of a long line shown on either side of the span. */
+#define DIAG_CONTEXT 256
+#define DIAG_ELLIPSIS "..."
 
-		char *next_newline = substr.buf;
-		while (*next_newline && *next_newline != '\n')
-			next_newline++;
+size_t display_width(const char *p, const char *end, size_t col)
+{
+	// jump from tab to tab, everything in between is one column per byte
+	const char *tab;
+	while (p < end && (tab = memchr(p, '\t', end - p)) != NULL)
+	{
+		col += tab - p;
+		col += tab_width - (col % tab_width);
+		p = tab + 1;
+	}
+	return col + (end - p);
+}
 
-		size_t line_len = next_newline - prev_newline;
-		size_t caret_pos = 0;
+void vdebug_print_line(FILE *stream, struct str_buf substr, char *line_start, char *line_end,
+		size_t line_num, u8 highlight_color, u8 caret_color, LOG_TYPE log_type,
+		const char *msg_fmt, va_list arg_list)
+{
+		if (log_type == LOG_DEBUG && !FLAG_SET(DEBUG))
+			return;
+		arena_reset(&diag_arena);
+
+		// only the part of a long line around the span is shown, so that each
+		// diagnostic costs the same however long its line is
+		char *shown_start = line_start, *shown_end = line_end;
+		if (substr.buf - line_start > DIAG_CONTEXT)
+			shown_start = substr.buf - DIAG_CONTEXT;
+		if (line_end - (substr.buf + substr.len) > DIAG_CONTEXT)
+			shown_end = substr.buf + substr.len + DIAG_CONTEXT;
+		const char *before = (shown_start != line_start) ? DIAG_ELLIPSIS : "";
+		const char *after = (shown_end != line_end) ? DIAG_ELLIPSIS : "";
+
+		size_t line_len = shown_end - shown_start;
+		size_t caret_pos = display_width(shown_start, substr.buf, strlen(before));
 		size_t n_tabs = 0;
-		for (char *c = prev_newline; c < substr.buf; ++c)
-		{
-			if (*c == '\t')
-			{
-				caret_pos += tab_width - (caret_pos % tab_width);
-				n_tabs++;
-			} else
-				caret_pos++;
-		}
-		
-		size_t col_n = substr.buf - prev_newline + 1;
+		for (char *c = shown_start; c < substr.buf; ++c)
+			n_tabs += (*c == '\t');
+
+		size_t col_n = substr.buf - line_start + 1;
+		size_t display_col_n = display_width(line_start, substr.buf, 0) + 1;
 
-		va_list arg_list;
-		va_start(arg_list, msg_fmt);
 		vflogf(log_type, stream, msg_fmt, arg_list);
-		va_end(arg_list);
 
 		if (ISCLR)
 		{
-			if (col_n != caret_pos+1)
+			if (col_n != display_col_n)
 				fprintf(stream, "\x1b[38;5;242m --> %s:%zu;%zu-%zu\n\x1b[0m",
-						substr.container_filename, line_num, col_n, caret_pos + 1);
+						substr.container_filename, line_num, col_n, display_col_n);
 			else
 				fprintf(stream, "\x1b[38;5;242m --> %s:%zu;%zu\n\x1b[0m",
 						substr.container_filename, line_num, col_n);
@@ -218,26 +405,24 @@ void debug_print_pos(FILE *stream, struct str_buf substr, char *container, size_
 			fprintf(stream, " --> %s:%zu;%zu\n",
 					substr.container_filename, line_num, col_n);
 
-		char *tildes_buf = malloc(substr.len-1 + 1); // -1 to exclude ^, +1 for '\0'
+		char *tildes_buf = arena_alloc(&diag_arena, substr.len-1 + 1); // -1 to exclude ^, +1 for '\0'
 		memset(tildes_buf, '~', substr.len-1);
 		tildes_buf[substr.len-1] = '\0';
 
 		if (!ISCLR)
 		{
-			fprintf(stream, "%5zu | %.*s\n"
+			fprintf(stream, "%5zu | %s%.*s%s\n"
 					    "%*s^%s\n",
-				line_num, (int) line_len, prev_newline,
+				line_num, before, (int) line_len, shown_start, after,
 				(int) caret_pos, "", tildes_buf);
 
-			free(tildes_buf);
-
 			return;
 		}
 
 		// 15 is the max byte len of the escape construction for the color
-		char *buf = calloc(line_len+1+15+tab_width*n_tabs, 1);
-		char *bufp = buf;
-		char *c = prev_newline;
+		char *buf = arena_calloc(&diag_arena, line_len+1+15+tab_width*n_tabs + 2*strlen(DIAG_ELLIPSIS));
+		char *bufp = stpcpy(buf, before);
+		char *c = shown_start;
 		while (c < substr.buf)
 		{
 			if (*c == '\t') {
@@ -254,8 +439,9 @@ void debug_print_pos(FILE *stream, struct str_buf substr, char *container, size_
 			*bufp++ = *c++;
 		strncpy(bufp, "\x1b[0m", 4);
 		bufp += 4;
-		while (c < next_newline)
+		while (c < shown_end)
 			*bufp++ = *c++;
+		strcpy(bufp, after);
 
 		#define NUM_COLOR "248"
 		fprintf(stream, SET_FG_ESC NUM_COLOR "m%4zu | "LOG_END"%s\n"
@@ -264,22 +450,38 @@ void debug_print_pos(FILE *stream, struct str_buf substr, char *container, size_
 			line_num, buf,
 			(int) caret_pos, "", caret_color, tildes_buf);
 
-		free(tildes_buf);
-		free(buf);
+}
+
+void debug_print_pos(FILE *stream, struct str_buf substr, char *container, size_t line_num, 
+		u8 highlight_color, u8 caret_color, LOG_TYPE log_type, const char *msg_fmt, ...)
+{
+		if (log_type == LOG_DEBUG && !FLAG_SET(DEBUG))
+			return;
+
+		char *prev_newline = substr.buf;
+		while (prev_newline > container && *(prev_newline-1) != '\n')
+			prev_newline--;
+
+		char *next_newline = substr.buf;
+		while (*next_newline && *next_newline != '\n')
+			next_newline++;
+
+		va_list arg_list;
+		va_start(arg_list, msg_fmt);
+		vdebug_print_line(stream, substr, prev_newline, next_newline, line_num,
+				highlight_color, caret_color, log_type, msg_fmt, arg_list);
+		va_end(arg_list);
 }
 #endif
 
 #define ESC_CHAR_SIZE 4
-bool temp_str_is_freed = false;
-
-static char *temp_str = NULL;
+// holds the latest escaped string; per-thread, so that lexers running on
+// different threads don't take back each other's strings
+static _Thread_local Arena temp_arena;
 
 struct str_buf dbg_escape_str(struct str_buf str)
 {
-	if (!temp_str_is_freed) {
-		free(temp_str);
-		temp_str_is_freed = true;
-	}
+	arena_reset(&temp_arena);
 
 	size_t num_escaped = 0;
 	char *strbufpos = str.buf;
@@ -291,7 +493,7 @@ struct str_buf dbg_escape_str(struct str_buf str)
 	}
 	const size_t retval_len = ESC_CHAR_SIZE*num_escaped + (str.len - num_escaped) + 1;
 
-	temp_str = malloc(retval_len);
+	char *temp_str = arena_alloc(&temp_arena, retval_len);
 	char *retval_pos = temp_str;
 	const char *buf_start = str.buf;
 	while (retval_pos < temp_str + retval_len && str.buf < buf_start + str.len) {
@@ -313,8 +515,8 @@ size_t chresc(char c, char *out)
 
 void freetmp(void)
 {
-	if (!temp_str_is_freed) {
-		free(temp_str);
-		temp_str_is_freed = true;
-	}
+	arena_free(&temp_arena);
+#ifndef BARE_UTIL_FLAG
+	arena_free(&diag_arena);
+#endif
 }
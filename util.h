@@ -70,6 +70,29 @@ void print_info(void);
  */
 struct str_buf read_file_to_string(const char *file_name);
 
+/* Bytes of zero padding that `load_source_file` guarantees after the
+ * terminating NUL, so vectorized scans can read a full block past the end.
+ */
+#define SOURCE_PADDING 64
+
+typedef struct {
+	struct str_buf contents; /* len includes the terminating NUL, like `read_file_to_string` */
+	size_t map_size; /* size of the mapping, or 0 if `contents.buf` was malloc'd */
+} SourceFile;
+
+/* Loads the file at `file_name` for lexing. Regular files are mapped
+ * read-only without copying; anything else (e.g. a pipe) is read into a
+ * malloc'd buffer. Either way the contents are followed by a NUL and
+ * `SOURCE_PADDING` more zero bytes, and must not be written to.
+ */
+SourceFile load_source_file(const char *file_name);
+void unload_source_file(SourceFile *file);
+
+/* A fast, non-cryptographic 64-bit hash of `len` bytes at `buf` (the
+ * structure of xxHash64), e.g. to tell whether a file has changed.
+ */
+u64 hash_bytes(const void *buf, size_t len, u64 seed);
+
 /* Writes the contents of `out_buf` (don't question naming) to 
  * the file at `dst_path`. Returns a value >= 0 if successful:
  * 0 if the buffer was succesfully written to the file.
@@ -86,11 +109,27 @@ s32 write_buf_to_file(struct str_buf buf, const char *dst_path);
 
 void debug_print_pos(FILE *stream, struct str_buf substr, char *container, size_t line_num,
 		u8 highlight_color, u8 caret_color, LOG_TYPE log_type, const char *msg_fmt, ...);
+/* The same for a caller that knows where the line of `substr` starts and
+ * ends (its '\n' or the end of the text), e.g. from a `LineIndex`, instead
+ * of scanning `container` for it.
+ */
+void vdebug_print_line(FILE *stream, struct str_buf substr, char *line_start, char *line_end,
+		size_t line_num, u8 highlight_color, u8 caret_color, LOG_TYPE log_type,
+		const char *msg_fmt, va_list arg_list);
+/* Returns the 0-based column after [p, end) starting from column `col`,
+ * with every tab going to the next multiple of `tab_width`.
+ */
+size_t display_width(const char *p, const char *end, size_t col);
 
-/* some kind of documentation should go here, probably. 
+/* Returns `strbuf` with control characters escaped like "<0a>". The result
+ * lives in per-thread scratch space and stays valid until the next call on
+ * the same thread (or `freetmp`).
  */
 struct str_buf dbg_escape_str(struct str_buf strbuf);
 size_t chresc(char c, char *out);
+/* Frees the calling thread's scratch space of dbg_escape_str and
+ * debug_print_pos.
+ */
 void freetmp(void);
 
 #endif /* UTIL_H */